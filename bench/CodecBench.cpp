@@ -0,0 +1,43 @@
+#include "Fixtures.h"
+
+#include "Codec.h"
+
+#include <benchmark/benchmark.h>
+
+// range(0) is the TileCodec, every codec is measured at its default level on the same tile
+static void BM_Encode(benchmark::State &state) {
+    const auto codec = Codec::Get(static_cast<TileCodec>(state.range(0)));
+    std::mt19937 rng(0);
+    const auto pixels = CreateTilePixels(rng);
+
+    size_t size = 0;
+    for (auto _ : state) {
+        const auto data = codec->Encode(tile_resolution, tile_resolution, pixels);
+        benchmark::DoNotOptimize(data.data());
+        size = data.size();
+    }
+
+    state.SetLabel(codec->name);
+    state.SetBytesProcessed(state.iterations() * pixels.size() * sizeof(uint32_t));
+    state.counters["ratio"] = static_cast<double>(pixels.size() * sizeof(uint32_t)) / static_cast<double>(size);
+}
+BENCHMARK(BM_Encode)->ArgName("codec")->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+static void BM_Decode(benchmark::State &state) {
+    const auto codec = Codec::Get(static_cast<TileCodec>(state.range(0)));
+    std::mt19937 rng(0);
+    const auto data = codec->Encode(tile_resolution, tile_resolution, CreateTilePixels(rng));
+    std::vector<uint32_t> pixels(tile_resolution * tile_resolution);
+
+    for (auto _ : state) {
+        if (!codec->Decode(data, pixels)) {
+            state.SkipWithError("Failed to decode the tile");
+            break;
+        }
+        benchmark::DoNotOptimize(pixels.data());
+    }
+
+    state.SetLabel(codec->name);
+    state.SetBytesProcessed(state.iterations() * pixels.size() * sizeof(uint32_t));
+}
+BENCHMARK(BM_Decode)->ArgName("codec")->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
\ No newline at end of file
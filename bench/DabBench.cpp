@@ -0,0 +1,23 @@
+#include "Dab.h"
+
+#include <benchmark/benchmark.h>
+
+// Dabs generated by Brush::PaintLine for a line of range(0) pixels at a 1 pixel step
+static void BM_DabInterpolate(benchmark::State &state) {
+    Dab start{};
+    start.pressure = 1.0f;
+    start.color = {0.0f, 0.0f, 0.0f, 1.0f};
+    Dab end = start;
+    end.position = {static_cast<float>(state.range(0)), 0.0f};
+    end.pressure = 0.5f;
+
+    size_t dabs = 0;
+    for (auto _ : state) {
+        const auto line = Dab::Interpolate(start, end, 1.0f);
+        benchmark::DoNotOptimize(Dab::GetBounds(line));
+        dabs += line.size();
+    }
+
+    state.SetItemsProcessed(dabs);
+}
+BENCHMARK(BM_DabInterpolate)->ArgName("length")->RangeMultiplier(8)->Range(8, 4096);
\ No newline at end of file
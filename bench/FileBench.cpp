@@ -0,0 +1,82 @@
+#include "Fixtures.h"
+
+#include "File.h"
+#include "ThreadPool.h"
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+
+// Written again on every run so that each commit benchmarks its own format and codecs, removed by the caller
+static std::filesystem::path CreateSketchbook(int tile_count) {
+    const auto filename =
+        std::filesystem::temp_directory_path() / ("mashiro-bench-" + std::to_string(tile_count) + ".msh");
+    std::filesystem::remove(filename);
+
+    std::mt19937 rng(tile_count);
+    auto file = File::New(filename, tile_resolution);
+    const int side = static_cast<int>(std::ceil(std::sqrt(tile_count)));
+    for (int i = 0; i < tile_count; i++) {
+        file->WriteTileTexture(i % side - side / 2, i / side - side / 2, CreateTilePixels(rng));
+    }
+    file->Save(filename);
+
+    return filename;
+}
+
+// Index only open followed by decoding every tile, as Canvas::Open does without the upload
+static void BM_OpenDecode(benchmark::State &state) {
+    const auto filename = CreateSketchbook(256);
+    auto pool = ThreadPool::Create(state.range(0));
+
+    size_t tiles = 0;
+    for (auto _ : state) {
+        auto file = File::Open(filename);
+        const auto coords = file->GetSavedTileLocation();
+        file->ReadTileTextures(coords, pool.get(), [](int x, int y, std::span<const uint32_t> pixels) {
+            benchmark::DoNotOptimize(pixels.data());
+        });
+        tiles += coords.size();
+    }
+
+    std::filesystem::remove(filename);
+    state.counters["tiles/s"] = benchmark::Counter(static_cast<double>(tiles), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_OpenDecode)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Headless part of Canvas::Save, the dirty tiles are encoded on the pool and appended to a new file
+static void BM_Save(benchmark::State &state) {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-bench-save.msh";
+    const auto tile_count = static_cast<int>(state.range(0));
+    auto pool = ThreadPool::Create(std::thread::hardware_concurrency());
+
+    std::mt19937 rng(tile_count);
+    std::vector<File::TileTexture> tiles;
+    for (int i = 0; i < tile_count; i++) {
+        tiles.push_back({i % 16, i / 16, CreateTilePixels(rng)});
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::filesystem::remove(filename);
+        auto file = File::New(filename, tile_resolution);
+        auto copy = tiles;
+        state.ResumeTiming();
+
+        file->WriteTileTextures(std::move(copy), pool.get());
+        file->Save(filename);
+    }
+
+    std::filesystem::remove(filename);
+    state.counters["tiles/s"] = benchmark::Counter(static_cast<double>(state.iterations() * tile_count),
+                                                   benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Save)->ArgName("tiles")->RangeMultiplier(4)->Range(4, 256)->UseRealTime()->Unit(benchmark::kMillisecond);
\ No newline at end of file
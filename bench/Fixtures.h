@@ -0,0 +1,32 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+constexpr int tile_resolution = 256;
+constexpr uint32_t tile_default_color = 0x00FFFFFF;
+
+// Tiles with a few strokes on the default color, close to what Canvas::Save writes
+inline std::vector<uint32_t> CreateTilePixels(std::mt19937 &rng) {
+    std::vector<uint32_t> pixels(tile_resolution * tile_resolution, tile_default_color);
+    std::uniform_real_distribution<float> position(0.0f, tile_resolution);
+    std::uniform_real_distribution<float> radius(1.0f, 4.5f);
+
+    for (int stroke = 0; stroke < 8; stroke++) {
+        float x = position(rng), y = position(rng);
+        const float dx = position(rng) / tile_resolution - 0.5f, dy = position(rng) / tile_resolution - 0.5f;
+        const float r = radius(rng);
+        for (int dab = 0; dab < 256; dab++, x += dx, y += dy) {
+            for (int py = std::max(0, int(y - r)); py < std::min(tile_resolution, int(y + r) + 1); py++) {
+                for (int px = std::max(0, int(x - r)); px < std::min(tile_resolution, int(x + r) + 1); px++) {
+                    if ((px - x) * (px - x) + (py - y) * (py - y) < r * r) {
+                        pixels[py * tile_resolution + px] = 0xFF000000;
+                    }
+                }
+            }
+        }
+    }
+
+    return pixels;
+}
\ No newline at end of file
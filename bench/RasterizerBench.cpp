@@ -0,0 +1,32 @@
+#include "Fixtures.h"
+
+#include "Rasterizer.h"
+
+#include <benchmark/benchmark.h>
+#include <glm/geometric.hpp>
+
+// A batch of range(1) dabs along the diagonal of a tile, painted with the backend range(0)
+static void BM_Rasterize(benchmark::State &state) {
+    const auto backend = static_cast<Rasterizer::Backend>(state.range(0));
+    if (!Rasterizer::IsSupported(backend)) {
+        state.SkipWithError("Backend not supported by this CPU");
+        return;
+    }
+
+    Dab start{};
+    start.pressure = 1.0f;
+    start.color = {0.0f, 0.0f, 0.0f, 0.5f};
+    Dab end = start;
+    end.position = {static_cast<float>(tile_resolution), static_cast<float>(tile_resolution)};
+    const auto dabs = Dab::Interpolate(start, end, glm::distance(start.position, end.position) / state.range(1));
+
+    std::vector<uint32_t> pixels(tile_resolution * tile_resolution, tile_default_color);
+    for (auto _ : state) {
+        Rasterizer::Paint(backend, dabs, {0, 0}, tile_resolution, pixels);
+        benchmark::DoNotOptimize(pixels.data());
+    }
+
+    state.SetLabel(Rasterizer::GetName(backend));
+    state.SetItemsProcessed(state.iterations() * dabs.size());
+}
+BENCHMARK(BM_Rasterize)->ArgNames({"backend", "dabs"})->ArgsProduct({{0, 1, 2, 3}, {64, 512}});
\ No newline at end of file
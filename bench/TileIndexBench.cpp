@@ -0,0 +1,81 @@
+#include "TileIndex.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <random>
+
+// A square canvas of range(0) tiles around the origin, as the Canvas and File indexes hold them
+static TileIndex CreateTileIndex(int tile_count) {
+    TileIndex index;
+    const int side = static_cast<int>(std::ceil(std::sqrt(tile_count)));
+    for (int i = 0; i < tile_count; i++) {
+        index.Insert(i % side - side / 2, i / side - side / 2, i);
+    }
+    return index;
+}
+
+static std::vector<std::pair<int, int>> CreateLookups(int tile_count, int spread) {
+    std::mt19937 rng(tile_count);
+    const int side = static_cast<int>(std::ceil(std::sqrt(tile_count))) * spread;
+    std::uniform_int_distribution<int> coord(-side / 2, side / 2);
+
+    std::vector<std::pair<int, int>> lookups(4096);
+    for (auto &[x, y] : lookups) {
+        x = coord(rng);
+        y = coord(rng);
+    }
+    return lookups;
+}
+
+static void BM_TileIndexFind(benchmark::State &state) {
+    const auto tile_count = static_cast<int>(state.range(0));
+    const auto index = CreateTileIndex(tile_count);
+    // A spread of 3 makes most lookups miss, like the culling and streaming of tiles never painted
+    const auto lookups = CreateLookups(tile_count, static_cast<int>(state.range(1)));
+
+    for (auto _ : state) {
+        for (const auto &[x, y] : lookups) {
+            benchmark::DoNotOptimize(index.Find(x, y));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * lookups.size());
+}
+BENCHMARK(BM_TileIndexFind)->ArgNames({"tiles", "spread"})->ArgsProduct({{1000, 10000, 100000, 1000000}, {1, 3}});
+
+static void BM_TileIndexInsert(benchmark::State &state) {
+    const auto tile_count = static_cast<int>(state.range(0));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CreateTileIndex(tile_count));
+    }
+
+    state.SetItemsProcessed(state.iterations() * tile_count);
+}
+BENCHMARK(BM_TileIndexInsert)->ArgName("tiles")->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+// Erase every tile in a random order, the index is rebuilt outside of the timing
+static void BM_TileIndexErase(benchmark::State &state) {
+    const auto tile_count = static_cast<int>(state.range(0));
+    const int side = static_cast<int>(std::ceil(std::sqrt(tile_count)));
+    std::vector<std::pair<int, int>> coords;
+    for (int i = 0; i < tile_count; i++) {
+        coords.push_back({i % side - side / 2, i / side - side / 2});
+    }
+    std::shuffle(coords.begin(), coords.end(), std::mt19937(tile_count));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto index = CreateTileIndex(tile_count);
+        state.ResumeTiming();
+
+        for (const auto &[x, y] : coords) {
+            index.Erase(x, y);
+        }
+        benchmark::DoNotOptimize(index.Size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * tile_count);
+}
+BENCHMARK(BM_TileIndexErase)->ArgName("tiles")->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
\ No newline at end of file
@@ -3,11 +3,12 @@
 out vec4 FragColor;
 
 in vec2 v_texcoord;
+flat in uint v_layer;
 
-layout (binding=0) uniform sampler2D layer;
+layout (binding=0) uniform sampler2DArray tiles;
 
 uniform vec3 tint;
 
 void main() {
-	FragColor = texture(layer, v_texcoord);
+	FragColor = texture(tiles, vec3(v_texcoord, v_layer));
 }
\ No newline at end of file
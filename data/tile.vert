@@ -1,4 +1,4 @@
-#version 420 core
+#version 430 core
 
 const vec2 vertices[6] = {
 	{0.0, 0.0},
@@ -14,16 +14,24 @@ layout(std140, binding = 0) uniform Matrices {
 	mat4 proj;
 } viewport;
 
-layout(std140, binding = 1) uniform TileData {
+struct TileData {
 	ivec2 coord;
 	uint layer;
 	uint size;
-} tile_data;
+};
+
+// One entry per instance, only the visible tiles are in it
+layout(std430, binding = 1) readonly buffer Tiles {
+	TileData tiles[];
+};
 
 out vec2 v_texcoord;
+flat out uint v_layer;
 
 void main() {
+	const TileData tile_data = tiles[gl_InstanceID];
 	v_texcoord = vertices[gl_VertexID];
+	v_layer = tile_data.layer;
 
 	const vec2 position = (vertices[gl_VertexID] + vec2(tile_data.coord)) * tile_data.size;
 	gl_Position = viewport.proj * viewport.view * vec4(position, 0.0, 1.0);
@@ -6,8 +6,8 @@ struct AABB {
     glm::vec2 min;
     glm::vec2 max;
 
-    static bool Overlap(AABB &a, AABB &b) noexcept {
-        // TODO
-        return true;
+    // Boxes that only share an edge do not overlap
+    static bool Overlap(const AABB &a, const AABB &b) noexcept {
+        return a.min.x < b.max.x && b.min.x < a.max.x && a.min.y < b.max.y && b.min.y < a.max.y;
     }
 };
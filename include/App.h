@@ -8,6 +8,7 @@
 #include "Inputs.h"
 #include "Preferences.h"
 #include "Renderer.h"
+#include "ThreadPool.h"
 #include "Viewport.h"
 #include "Window.h"
 
@@ -39,10 +40,16 @@ class App final {
 
     bool Save();
     bool SaveAs();
+    // Keep the viewport and a thumbnail of the last frame in the file, Open resumes from that viewport
+    void SavePreview();
     bool Open();
+    // Open filename without asking anything and resume the view it was saved with
+    void OpenFile(std::filesystem::path filename);
     bool New();
     void Exit();
 
+    tstring GetDisplayName() const;
+
     void EnableBrush(bool enable);
 
     void Init(HWND hwnd);
@@ -65,10 +72,12 @@ class App final {
     std::unique_ptr<Window> _window;
 
     std::unique_ptr<Preferences> _preferences;
+    std::unique_ptr<ThreadPool> _thread_pool;
 
     std::unique_ptr<File> _file;
     std::unique_ptr<Canvas> _canvas;
     std::unique_ptr<Viewport> _viewport;
+    std::unique_ptr<Uniformbuffer> _viewport_uniformbuffer;
 
     // TODO: Convert to tools
     std::unique_ptr<Brush> _brush;
@@ -1,9 +1,12 @@
 #pragma once
+#include "AABB.h"
+#include "Dab.h"
 #include "Renderer.h"
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <vector>
 
 class Canvas;
 class Viewport;
@@ -19,17 +22,7 @@ class Brush {
 public:
 	static void Init();
 
-	struct BrushData {
-		// TODO: Convert this data to canvas coord
-		float pressure;
-		float tilt;
-		float orientation;
-		float rotation;
-		glm::vec2 position;		// Window relative pos
-		float padding[2];
-		glm::vec4 color;		// Color + Opacity
-		// this is temporay in the future this should use other type of data namely the parameter of the brush (hardness, radius, etc...)
-	};
+	using BrushData = Dab;
 
 	Brush(const Brush&) = delete;
 	Brush(Brush&&) = delete;
@@ -53,10 +46,24 @@ public:
 	float GetRotation();
 
 	void SetBrushData(BrushData data);
-	void SetBrushDatas(std::span<BrushData> data);
+	// Any number of dabs, they are painted by a single dispatch per tile
+	void SetBrushDatas(std::span<const BrushData> data);
 	BrushData GetBrushData();
+	// Canvas area the current dabs can paint, min is above max when they cannot paint anything
+	AABB GetBounds() const;
+
+	// Part of a tile painted by the current dabs, laid out like TileDispatch in brush.comp
+	struct BrushTile {
+		glm::ivec2 coord;
+		// Only the pixels from offset to offset + size are dispatched, they must cover the dabs inside this tile
+		glm::ivec2 offset;
+		glm::ivec2 size;
+		std::uint32_t layer;
+		std::uint32_t padding;
+	};
 
-	void Paint(Texture* texture);
+	// Every tile is painted by a single dispatch, or on the CPU when Preferences::_brush_cpu is set
+	void Paint(TextureArray* tiles, std::span<const BrushTile> parts);
 	void PaintLine(Canvas* canvas, BrushData start, BrushData end, float step);
 	void Paint(Canvas* canvas, BrushData data);
 	void Render();
@@ -64,6 +71,8 @@ public:
 
 private:
 	BrushData _brush_data;
+	std::vector<BrushData> _brush_datas;
+	AABB _bounds;
 
 	std::unique_ptr<Texture> _alpha;
 	std::unique_ptr<Program> _compute_program;
@@ -72,7 +81,7 @@ private:
 	static std::unique_ptr<Program> _program;
 	static std::unique_ptr<Mesh> _mesh;
 	static std::unique_ptr<Uniformbuffer> _brush_ubo;
-	static std::unique_ptr<Uniformbuffer> _brush_compute_ubo;
-	static std::uint32_t _brush_ubo_size;
+	static std::unique_ptr<Storagebuffer> _brush_storage;
+	static std::unique_ptr<Storagebuffer> _tiles_storage;
 };
 
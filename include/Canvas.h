@@ -3,10 +3,15 @@
 #include "Brush.h"
 #include "File.h"
 #include "Framework.h"
+#include "Prefetcher.h"
+#include "Pyramid.h"
+#include "TileIndex.h"
 
+#include <cstdint>
 #include <filesystem>
+#include <future>
+#include <glm/common.hpp>
 #include <glm/vec2.hpp>
-#include <map>
 #include <memory>
 #include <vector>
 
@@ -27,11 +32,13 @@ class Canvas {
 
     static std::unique_ptr<Canvas> New();
     void Load(glm::ivec2 coord, File *file);
+    // Nothing is decoded here, the tiles are streamed from the file once they come near the viewport
     static std::unique_ptr<Canvas> Open(File *file);
 
     bool IsSaved() const;
     void Save(File *file);
     void LazyLoad(glm::vec2 cursor, File *file);
+    // Also evicts the least recently viewed saved tiles from the pool above Preferences::_tile_memory_budget
     void LazySave(glm::vec2 cursor, File *file);
 
     void SaveTile(size_t i, File *file);
@@ -39,6 +46,7 @@ class Canvas {
     void Refresh();
     void Paint(Brush *brush);
 
+    // Streams the tiles from the file of the app, then draws the visible ones of the pyramid level of the zoom
     void Render(Viewport *viewport);
 
     /* Layers */
@@ -60,31 +68,130 @@ class Canvas {
 
     /* Tiles */
 
+    // Laid out like TileData in tile.vert
     struct Tile {
         glm::ivec2 coord;
         std::uint32_t layer;
         std::uint32_t size;
     };
 
+    // Pixels of a tile changed since it was last saved, in tile pixels and max is exclusive
+    struct TileRect {
+        glm::ivec2 min = {0, 0};
+        glm::ivec2 max = {0, 0};
+
+        bool IsEmpty() const noexcept {
+            return min.x >= max.x || min.y >= max.y;
+        }
+
+        TileRect Union(const TileRect &other) const noexcept {
+            if (IsEmpty()) {
+                return other;
+            }
+            if (other.IsEmpty()) {
+                return *this;
+            }
+            return {glm::min(min, other.min), glm::max(max, other.max)};
+        }
+    };
+
   private:
+    // Read back the tile pixels and mark it as saved
+    File::TileTexture ReadTile(size_t i);
+    // Same without stalling, the pixels are collected by a later LazySave or Save
+    void RequestReadback(size_t i);
+    void QueueReadback(const Tile &tile, int lod);
+
     void CreateTile(glm::ivec2 coord);
     void DeleteTile(glm::ivec2 coord);
+    // A tile is resident while it has a layer of the pool, evicted tiles are read again from the file
+    bool IsResident(size_t i) const;
+    // Upload the pixels of the file to the layer of the tile, or the default pixels when it is not in it
+    void FillTile(size_t i, File *file);
+    void RestoreTile(size_t i, File *file);
+    // Load the tiles under the viewport and its margin that are in the file but not in the pool, nearest first
+    void StreamTiles(Viewport *viewport, File *file);
+    // Decode on the workers the tiles where the viewport is heading, they are uploaded on a later frame
+    void PrefetchTiles(Viewport *viewport, File *file);
+    // Upload the pixels of a tile that is not in the pool yet, nothing is done if it was loaded meanwhile
+    void UploadTile(glm::ivec2 coord, std::span<const uint32_t> pixels);
+    void EvictTile(size_t i);
+    void EvictTiles(File *file);
+    std::uint32_t AllocateLayer();
     void ReloadTile(glm::ivec2 coord);
     void RenderTiles();
-    void CullTiles(Viewport *viewport);
-
-    std::map<std::pair<int, int>, size_t> _coord_tile;
+    void CullTiles(Viewport *viewport, int level);
+
+    // Zoomed out the tiles of the level saved in the file are loaded, the tiles under the others that were never
+    // loaded are only loaded to be downsampled in the pyramid
+    void BuildPyramid(Viewport *viewport, File *file, int level);
+    // Downsample the stale tiles in their parent level after level, the missing parents are read from the file
+    // or else built from every child they have, in the pool or in the file
+    void UpdatePyramid(File *file);
+    // Add to stale the other children of the parent of coord when it is not in the file, the ones that are only in
+    // the file are loaded first so that the parent is built from all of them
+    void LoadSiblings(int level, glm::ivec2 coord, File *file, std::vector<glm::ivec2> &stale);
+    void MarkStale(size_t i);
+    size_t CreateLevelTile(int level, glm::ivec2 coord, bool complete);
+
+    TileIndex _coord_tile;
     std::vector<Tile> _tiles_data;
     std::vector<AABB> _tiles_aabb;
     std::vector<bool> _tiles_visibility;
+    // Indexes of the tiles visible on the last frame
+    std::vector<size_t> _tiles_visible;
     std::vector<bool> _tiles_processing;
-    std::vector<bool> _tiles_saved;
-    std::vector<Texture> _tiles_textures;
+    std::vector<TileRect> _tiles_dirty;
+    // Frame on which each tile was last visible, the oldest ones are evicted first
+    std::vector<std::uint64_t> _tiles_viewed;
+    std::uint64_t _frame;
+    // Tiles changed since they were downsampled in the pyramid, they are not evicted before that
+    std::vector<bool> _tiles_stale;
+    std::vector<glm::ivec2> _stale;
+
+    // Level n of the pyramid is _levels[n - 1], its tiles are always resident and sized to the canvas area they cover
+    struct Level {
+        TileIndex coord_tile;
+        std::vector<Tile> tiles;
+        std::vector<bool> stale;
+        // Changed since it was written to the file
+        std::vector<bool> dirty;
+    };
+    std::vector<Level> _levels;
+    // Level drawn on the last frame and the indexes of its visible tiles when it is not 0
+    int _level;
+    std::vector<size_t> _levels_visible;
+    // The partial tiles of the levels stay dirty until they are complete
+    PyramidCoverage _coverage;
+
+    // Every resident tile is a layer of the pool, the layers of the deleted and evicted tiles are reused first
+    static constexpr std::uint32_t no_layer = UINT32_MAX;
+    std::unique_ptr<TextureArray> _tiles_pool;
+    std::vector<std::uint32_t> _layers_free;
+    std::uint32_t _layers_used;
+
+    // In request order, a tile can be in it more than once if it was painted again since
+    struct PendingReadback {
+        glm::ivec2 coord;
+        int lod;
+        std::unique_ptr<Readback> readback;
+    };
+    std::vector<PendingReadback> _readbacks;
+    std::vector<std::unique_ptr<Readback>> _readbacks_free;
+
+    struct PendingDecode {
+        glm::ivec2 coord;
+        std::future<std::vector<uint32_t>> pixels;
+    };
+    std::vector<PendingDecode> _decodes;
+    Prefetcher _prefetcher;
 
     bool _saved;
 
-    static std::unique_ptr<Uniformbuffer> _tile_ubo;
+    // Visible tiles of the frame, one instance each
+    static std::unique_ptr<Storagebuffer> _tile_instances;
     static std::unique_ptr<Program> _program;
+    static std::unique_ptr<Program> _downsample_program;
     static std::unique_ptr<Mesh> _mesh;
     static std::vector<uint32_t> _pixels;
 };
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Stored in every HEADER entry, the values are on disk and must never be reused
+enum class TileCodec : std::uint32_t {
+    Png = 0,
+    Lz4 = 1,
+    Zstd = 2,
+    // Every pixel has the color stored in the HEADER entry, there is no BODY and no Codec for it
+    Uniform = 3,
+};
+
+// Encoder and decoder of a tile BODY, every tile of a file can use a different one
+struct Codec {
+    TileCodec id;
+    const char *name;
+    int default_level;
+    int min_level;
+    int max_level;
+
+    // level is already clamped to [min_level, max_level]
+    std::vector<std::uint8_t> (*encode)(int width, int height, std::span<const std::uint32_t> pixels, int level);
+    bool (*decode)(std::span<const std::uint8_t> data, std::span<std::uint32_t> pixels);
+
+    // level -1 uses default_level, an empty result means the encoding failed
+    std::vector<std::uint8_t> Encode(int width, int height, std::span<const std::uint32_t> pixels,
+                                     int level = -1) const;
+    // pixels must already have the size of the tile, false if the data is corrupted or does not match that size
+    bool Decode(std::span<const std::uint8_t> data, std::span<std::uint32_t> pixels) const;
+
+    static const Codec *Get(TileCodec id);
+    static const Codec *Find(std::string_view name);
+    static std::span<const Codec> All();
+};
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include "AABB.h"
+
+#include <span>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+// One stamp of the brush, the layout matches BrushData in brush.comp (48 bytes in std140 and std430)
+struct Dab {
+    // TODO: Convert this data to canvas coord
+    float pressure;
+    float tilt;
+    float orientation;
+    float rotation;
+    glm::vec2 position; // Window relative pos
+    float padding[2];
+    glm::vec4 color; // Color + Opacity
+    // this is temporay in the future this should use other type of data namely the parameter of the brush (hardness,
+    // radius, etc...)
+
+    // Must match the radius of a dab in brush.comp
+    static constexpr float radius = 4.5f;
+
+    // Dabs every step along the line, the first one is start and the last one is end
+    static std::vector<Dab> Interpolate(const Dab &start, const Dab &end, float step);
+    // Canvas area the dabs can paint, min is above max when they cannot paint anything
+    static AABB GetBounds(std::span<const Dab> dabs);
+};
+
+static_assert(sizeof(Dab) == 48, "Dab must keep the layout of BrushData in brush.comp");
\ No newline at end of file
@@ -1,10 +1,19 @@
 #pragma once
-#include "Framework.h"
+#include "Codec.h"
+#include "MappedFile.h"
+#include "Pyramid.h"
+#include "ThreadPool.h"
+#include "TileIndex.h"
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
 #include <glm/vec2.hpp>
-#include <map>
+#include <memory>
 #include <optional>
 #include <span>
+#include <unordered_map>
 #include <vector>
 
 /* Custom file format for Mashiro
@@ -12,18 +21,46 @@
  * BOM:          endiness[2]
  * file_type:    char[6]
  * file_version: uint8_t[4] 255.255.255.255
- * header_size:  uint64_t[1]
+ * footer:       uint64_t[1] offset of the last complete FOOTER
+ *
+ * BODY
+ * encoded tiles, each one with the codec of its HEADER entry (see Codec.h),
+ * every save appends the tiles that changed followed by a new HEADER and FOOTER
  *
  * HEADER
- * tile_resolution uint32_t[1]
  * entry:
  *   coord: int32_t[2]
  *   start: uint64_t[1];
  *   len:   uint64_t[1];
+ *   codec: uint32_t[1] TileCodec, missing before 0.0.4.0 where every tile is PNG
+ *   color: uint32_t[1] color of the whole tile when codec is Uniform, the tile then has no BODY
+ *   hash:  uint64_t[1] xxh3 of the raw pixels, 0 before 0.0.6.0. Entries with the same hash share one BODY
+ *   lod:   uint32_t[1] level of the pyramid of the tile (see Pyramid.h), 0 for the canvas tiles and before 0.0.7.0
+ *   padding: uint32_t[1]
  *
+ * PREVIEW, since 0.0.8.0 between the HEADER and its FOOTER, absent when they are contiguous
+ * file_type:    char[4]
+ * position:     float[2] of the viewport when it was saved
+ * zoom:         float[1]
+ * rotation:     float[1]
+ * width:        uint32_t[1] of the thumbnail
+ * height:       uint32_t[1]
+ * len:          uint32_t[1] of the thumbnail that follows, a PNG of the view with its rows top to bottom
  *
- * BODY
- * saved webp losless of all the texture available in uint8_t
+ * FOOTER
+ * file_type:    char[4]
+ * header_count: uint32_t[1]
+ * header_size:  uint32_t[1] size of one entry, newer entries only add fields at the end
+ * padding:      uint32_t[1]
+ * header_start: uint64_t[1]
+ * previous:     uint64_t[1] offset of the previous FOOTER, 0 for the first one
+ *
+ * Files before 0.0.3.0 have a single HEADER right after INFO and no FOOTER
+ *
+ * When opened mapped only INFO and HEADER are parsed, the BODY stays in the mapping
+ * and each tile is decoded from it when it is first requested
+ *
+ * A preview only needs INFO, the last FOOTER and PREVIEW, a few KB whatever the size of the canvas
  */
 
 class File {
@@ -35,8 +72,9 @@ class File {
     File();
     ~File();
 
-    static std::unique_ptr<File> New(std::filesystem::path filename);
-    static std::unique_ptr<File> Open(std::filesystem::path filename);
+    static std::unique_ptr<File> New(std::filesystem::path filename, int tile_resolution);
+    // generation 0 is the last save, 1 the save before it, etc...
+    static std::unique_ptr<File> Open(std::filesystem::path filename, bool mapped = true, size_t generation = 0);
 
     void Rename(std::filesystem::path filename);
     std::filesystem::path GetFilename() const;
@@ -45,40 +83,195 @@ class File {
     bool IsNew() const;
 
     void Save(std::filesystem::path filename);
-    tstring GetDisplayName();
+    // Write a compacted copy with only the reachable tiles, without codec the tiles are copied as they are
+    // This File keeps referring to its own file unless filename is that file
+    void Repack(std::filesystem::path filename, std::optional<TileCodec> codec = std::nullopt, int level = -1);
 
-    std::vector<std::pair<int, int>> GetSavedTileLocation() const;
+    // Every tile is keyed by its coord and the level of the pyramid it is part of, lod 0 being the canvas tiles
+    // In no particular order
+    std::vector<std::pair<int, int>> GetSavedTileLocation(int lod = 0) const;
+    size_t GetSavedTileCount(int lod = 0) const;
     int GetTileResolution() const;
 
-    bool HasTile(int x, int y) const;
-    std::vector<uint32_t> ReadTileTexture(int x, int y);
-    void WriteTileTexture(int x, int y, std::vector<uint32_t> pixels, int compression = 4);
+    struct TileTexture {
+        int x;
+        int y;
+        std::vector<uint32_t> pixels;
+        int lod = 0;
+    };
+
+    struct EncodedTile {
+        int x;
+        int y;
+        TileCodec codec;
+        std::uint32_t color;
+        std::uint64_t hash;
+        std::vector<uint8_t> data;
+        int lod = 0;
+    };
+
+    bool HasTile(int x, int y, int lod = 0) const;
+    // Color of a tile stored as TileCodec::Uniform, it can be filled without decoding anything
+    std::optional<std::uint32_t> GetTileColor(int x, int y, int lod = 0) const;
+    std::optional<TileCodec> GetTileCodec(int x, int y, int lod = 0) const;
+    std::vector<uint32_t> ReadTileTexture(int x, int y, int lod = 0) const;
+    void ReadTileTexture(int x, int y, std::span<uint32_t> pixels, int lod = 0) const;
+    // Decode a tile on the pool from a copy of its BODY, so this File can keep committing and saving meanwhile
+    // pool can be nullptr to decode it right away, the future throws if the tile is corrupted
+    std::future<std::vector<uint32_t>> ReadTileTextureAsync(int x, int y, ThreadPool *pool, int lod = 0) const;
+    // Decode the tiles on the pool into a few reused buffers, callback is called in order on the calling thread
+    void ReadTileTextures(std::span<const std::pair<int, int>> coords, ThreadPool *pool,
+                          std::function<void(int x, int y, std::span<const uint32_t> pixels)> callback,
+                          int lod = 0) const;
+    // level -1 is the default level of the codec
+    void WriteTileTexture(int x, int y, std::vector<uint32_t> pixels, TileCodec codec = TileCodec::Png,
+                          int level = -1);
+    // Encode every tile on the pool and only then update the index, pool can be nullptr to encode serially
+    // Tiles that did not change are skipped and copies of a content already in the file share its BODY
+    void WriteTileTextures(std::vector<TileTexture> tiles, ThreadPool *pool, TileCodec codec = TileCodec::Png,
+                           int level = -1);
+    // Same as WriteTileTextures without waiting for the encoding, the tiles are added to the index by
+    // CommitTileTextures, which returns true once every queued tile is committed. Save commits all of them first
+    void QueueTileTextures(std::vector<TileTexture> tiles, ThreadPool *pool, TileCodec codec = TileCodec::Png,
+                           int level = -1);
+    bool CommitTileTextures(bool wait);
+    // Encode again with codec the tiles committed since the last save with another one, so that what the lazy saves
+    // encoded fast is saved with the codec of an explicit save. pool can be nullptr to encode serially
+    void RecodeTileTextures(ThreadPool *pool, TileCodec codec, int level = -1);
+
+    // Encoding does not touch the index so it can run on any thread, committing must be done on the owning thread
+    // Tiles of a single color are always stored as TileCodec::Uniform
+    // Writing, queuing, recoding or repacking with a codec that is not in Codec::All throws
+    EncodedTile EncodeTileTexture(int x, int y, std::span<const uint32_t> pixels, TileCodec codec = TileCodec::Png,
+                                  int level = -1) const;
+    void CommitTileTexture(EncodedTile tile);
+
+    // Last view of the canvas, to resume it on open and show it before opening
+    struct Preview {
+        glm::vec2 position;
+        float zoom;
+        float rotation;
+        int width;
+        int height;
+        // Rows top to bottom
+        std::vector<uint32_t> thumbnail;
+    };
+
+    // Largest side of a thumbnail
+    static constexpr int thumbnail_size = 128;
+    // pixels are the view with its rows top to bottom, they are downscaled to fit in thumbnail_size
+    static Preview CreatePreview(glm::vec2 position, float zoom, float rotation, std::span<const uint32_t> pixels,
+                                 int width, int height);
+    // Written with the next save, the previous one is kept until then
+    void SetPreview(const Preview &preview);
+    // Preview of the opened generation or the one set since, nullopt before 0.0.8.0
+    std::optional<Preview> GetPreview() const;
+    // Only reads INFO, the last complete FOOTER and PREVIEW without parsing the file
+    static std::optional<Preview> ReadPreview(std::filesystem::path filename);
 
   private:
+    void ReadIndex(std::span<const uint8_t> data, size_t generation);
+    void Append();
+    // Returns true when this File now refers to the written copy, which is always the case when it replaces it
+    bool Rewrite(std::filesystem::path filename, std::optional<TileCodec> codec, int level, bool adopt);
+    void Reload(std::filesystem::path filename);
+    // Copy the BODY of every tile out of data, the tiles pointing at the same one share it
+    void LoadBlobs(std::span<const uint8_t> data);
+    std::span<const uint8_t> GetTileData(size_t index) const;
+    bool Decode(size_t index, std::span<uint32_t> pixels) const;
+    // data is the whole PREVIEW, nullopt if it is corrupted
+    static std::optional<Preview> ParsePreview(std::span<const uint8_t> data);
+
+    static std::uint64_t Hash(std::span<const uint32_t> pixels);
+    // Hash of the last content written to this tile, even if it is still being encoded
+    std::optional<std::uint64_t> GetLatestHash(int x, int y, int lod) const;
+    std::optional<size_t> FindTile(std::uint64_t hash) const;
+    size_t GetOrCreateTile(int x, int y, int lod);
+    void ShareTile(int x, int y, int lod, size_t source);
+    // hash is the one of pixels, which the callers already know
+    EncodedTile EncodeTileTexture(int x, int y, std::span<const uint32_t> pixels, std::uint64_t hash, TileCodec codec,
+                                  int level) const;
+    // Throws for a level that is not in the pyramid
+    const TileIndex &GetIndex(int lod) const;
+    void CopyTileBody(size_t index, size_t source);
+
     // store all the tile and is referenced by the canvas after
 
     std::filesystem::path _filename;
     bool _save_on_close;
     bool _saved;
     bool _new;
+    bool _mapped;
 
     // INFO
     struct Info {
         char _type[4];
         std::uint8_t _version[4];
-        std::uint64_t _size;
-        std::uint32_t _header_count;
+        std::uint64_t _footer;
+        std::uint32_t _header_count; // Only used before 0.0.3.0
         std::uint32_t _resolution;
     } _info;
 
-    std::map<std::pair<int, int>, size_t> _textures_indexes;
+    // One index for every level of the pyramid
+    std::array<TileIndex, Pyramid::max_level + 1> _textures_indexes;
+    // Last tile committed with each content, can be stale if that tile changed since
+    std::unordered_map<std::uint64_t, size_t> _hash_indexes;
 
     // BODY
-    std::vector<std::vector<uint8_t>> _pngs;
+    // A null entry means the tile is still only in the mapping, tiles with the same content share theirs
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> _blobs;
+    std::vector<bool> _dirty;
+    std::unique_ptr<MappedFile> _mapping;
 
     struct TileHeader {
         std::int32_t coord[2];
         std::uint64_t start;
         std::uint64_t len;
+        std::uint32_t codec;
+        std::uint32_t color;
+        std::uint64_t hash;
+        std::uint32_t lod;
+        std::uint32_t padding;
+    };
+
+    // HEADER as it is on disk
+    std::vector<TileHeader> _headers;
+
+    struct Footer {
+        char _type[4];
+        std::uint32_t _header_count;
+        std::uint32_t _header_size;
+        std::uint32_t _padding;
+        std::uint64_t _header_start;
+        std::uint64_t _previous;
     };
+
+    std::uint64_t _footer_offset;
+
+    struct PreviewHeader {
+        char _type[4];
+        float _position[2];
+        float _zoom;
+        float _rotation;
+        std::uint32_t _width;
+        std::uint32_t _height;
+        std::uint32_t _len;
+    };
+
+    // PREVIEW as it is on disk, empty when there is none
+    std::vector<uint8_t> _preview;
+
+    // A tile without encoded future is a copy of another content, it is shared when committed
+    struct QueuedTile {
+        int x;
+        int y;
+        int lod;
+        std::uint64_t hash;
+        TileCodec codec;
+        int level;
+        std::shared_ptr<const std::vector<uint32_t>> pixels;
+        std::future<EncodedTile> encoded;
+    };
+
+    std::deque<QueuedTile> _queue;
 };
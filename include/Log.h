@@ -1,5 +1,5 @@
 #pragma once
-#include "Framework.h"
+#include <string>
 
 class Log {
 public:
@@ -8,6 +8,8 @@ public:
 	Log& operator=(const Log&) = delete;
 	Log& operator=(Log&&) = delete;
 
-	static void Info(const tstring& msg) noexcept;
-	static void Trace(const tstring& msg) noexcept;
-};
+	static void Info(const std::string& msg) noexcept;
+	static void Trace(const std::string& msg) noexcept;
+	static void Info(const std::wstring& msg) noexcept;
+	static void Trace(const std::wstring& msg) noexcept;
+};
\ No newline at end of file
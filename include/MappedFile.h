@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+// Read only view of a whole file mapped in memory, pages are only loaded by the OS when they are accessed
+class MappedFile {
+  public:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+    MappedFile();
+    ~MappedFile();
+
+    static std::unique_ptr<MappedFile> Open(std::filesystem::path filename);
+
+    std::span<const std::uint8_t> Data() const noexcept;
+    std::size_t Size() const noexcept;
+
+  private:
+    void Release();
+
+    void *_file;
+    void *_mapping;
+    const std::uint8_t *_data;
+    std::size_t _size;
+};
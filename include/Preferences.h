@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Codec.h"
 #include "Framework.h"
 #include <queue>
 #include <filesystem>
@@ -25,11 +26,30 @@ public:
 
 	int _tile_resolution;
 	int _lazy_save_count;
+	// Memory of the tiles kept on the GPU in MiB, the saved tiles viewed the longest time ago are evicted above it
+	int _tile_memory_budget;
+	// Tiles around the viewport loaded ahead of being visible, and how many of them are loaded per frame
+	int _tile_stream_margin;
+	int _tile_stream_count;
+	// Seconds ahead of the viewport movement where tiles are prefetched, and how many are decoded at once
+	float _tile_prefetch_time;
+	int _tile_prefetch_count;
 	std::uint32_t _tile_default_color;
 
 	int _file_recents_max;	
 	std::queue<std::filesystem::path> _file_recents;
 	std::filesystem::path _file_last_openned;
 	float _brush_step;
+	// Paint with the Rasterizer instead of brush.comp, every painted tile is read back and uploaded again
+	bool _brush_cpu;
+
+	// Number of workers used to encode and decode tiles, 0 uses every hardware thread
+	int _thread_pool_size;
+
+	// Codec and level of the tiles written by an explicit save and by the lazy save, level -1 is the codec default
+	TileCodec _save_codec;
+	int _save_codec_level;
+	TileCodec _lazy_save_codec;
+	int _lazy_save_codec_level;
 };
 
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Viewport.h"
+#include <glm/vec2.hpp>
+
+// Follows the viewport from frame to frame to guess where it will be a moment later
+class Prefetcher {
+  public:
+    Prefetcher();
+
+    // time is in seconds, only its difference between two calls matters
+    void Update(const Viewport &viewport, double time);
+    // The viewport after moving and zooming at the current rates for ahead seconds
+    Viewport Predict(const Viewport &viewport, float ahead) const;
+
+    // In viewport position units per second
+    glm::vec2 GetVelocity() const noexcept;
+    // Natural log of the zoom per second, so zooming in and out at the same pace have opposite rates
+    float GetZoomRate() const noexcept;
+
+    // Frames further apart than this start a new movement, the view was still in between
+    static constexpr double max_interval = 0.25;
+
+  private:
+    bool _started;
+    double _time;
+    glm::vec2 _position;
+    float _zoom;
+
+    glm::vec2 _velocity;
+    float _zoom_rate;
+};
\ No newline at end of file
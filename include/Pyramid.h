@@ -0,0 +1,47 @@
+#pragma once
+#include "TileIndex.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+// Level of detail of the canvas, level 0 is the tiles themselves and a tile of level n is a half resolution copy of
+// the 2x2 tiles of level n - 1 under it. Every level has the tile resolution, so its tiles cover 2^n times more canvas
+struct Pyramid {
+    // A tile of the last level covers 256x256 tiles of the canvas
+    static constexpr int max_level = 8;
+
+    // Tile of the next level over coord, and the quadrant of that tile where coord is downsampled
+    static glm::ivec2 GetParent(glm::ivec2 coord) noexcept;
+    static glm::ivec2 GetQuadrant(glm::ivec2 coord) noexcept;
+    // Tile levels above coord that covers it
+    static glm::ivec2 GetAncestor(glm::ivec2 coord, int levels) noexcept;
+
+    // Coarsest level that still has at least one texel per pixel of the window at this zoom
+    static int GetLevel(float zoom) noexcept;
+};
+
+// A tile of the pyramid is complete once every quadrant with tiles under it was downsampled from a complete child,
+// the tiles of the canvas being complete. Only complete tiles are saved, or trusted over the tiles under them
+class PyramidCoverage {
+  public:
+    // A tile of the canvas exists at coord, in the file or in the pool
+    void AddTile(glm::ivec2 coord);
+    // Some tile of the canvas is under coord of level, level 0 being the tiles of the canvas
+    bool HasContent(int level, glm::ivec2 coord) const;
+
+    // A tile read from the file is complete, otherwise only its quadrants without tiles under them are
+    void AddLevelTile(int level, glm::ivec2 coord, bool complete);
+    // child of level - 1 was downsampled in its quadrant of the tile of level over it, which was added
+    void SetDownsampled(int level, glm::ivec2 child);
+    // Always true for the tiles of the canvas and false for the tiles of level that were not added
+    bool IsComplete(int level, glm::ivec2 coord) const;
+
+  private:
+    std::array<TileIndex, Pyramid::max_level + 1> _content;
+    // Index of each tile added to a level in its quadrants, one bit per quadrant that is downsampled
+    std::array<TileIndex, Pyramid::max_level + 1> _tiles;
+    std::array<std::vector<std::uint8_t>, Pyramid::max_level + 1> _quadrants;
+};
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include "Dab.h"
+
+#include <cstdint>
+#include <span>
+
+#include <glm/vec2.hpp>
+
+/* CPU version of the dab kernel of data/brush.comp
+ * Every pixel inside the radius of a dab is mixed with its color by its alpha, in the order of the dabs,
+ * and rounded back to RGBA8 after each dab like imageStore does.
+ *
+ * All the backends give the same bytes on x86, NEON can differ by one unit if the compiler fuses the
+ * multiply-adds. brush.comp matches within one unit per channel and per dab, the rounding of the
+ * unorm conversion and the precision of distance() are left to the GL implementation.
+ */
+class Rasterizer {
+  public:
+    enum class Backend {
+        Scalar,
+        Sse2,
+        Avx2,
+        Neon,
+    };
+
+    // pixels is the resolution x resolution RGBA8 tile at coord, with red in the low byte like the tile textures
+    static void Paint(std::span<const Dab> dabs, glm::ivec2 coord, int resolution, std::span<std::uint32_t> pixels);
+    static void Paint(Backend backend, std::span<const Dab> dabs, glm::ivec2 coord, int resolution,
+                      std::span<std::uint32_t> pixels);
+
+    // Fastest backend supported by this CPU
+    static Backend GetBackend();
+    static bool IsSupported(Backend backend);
+    static const char *GetName(Backend backend);
+};
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "Framework.h"
+#include <deque>
 #include <filesystem>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/mat4x4.hpp>
@@ -52,7 +53,8 @@ class Texture {
     void GenerateMipmaps();
 
     std::vector<uint32_t> ReadPixels() const;
-    void SetPixels(std::span<uint32_t> pixels);
+    void SetPixels(std::span<const uint32_t> pixels);
+    void Fill(uint32_t color);
 
     void Bind(GLenum unit) const noexcept;
 
@@ -69,6 +71,115 @@ class Texture {
     GLsizei _height;
 };
 
+// Layers of the same size in one RGBA8 texture, so what lives in them can be painted and drawn together
+class TextureArray {
+  public:
+    TextureArray(const TextureArray &) = delete;
+    TextureArray &operator=(const TextureArray &) = delete;
+    TextureArray(TextureArray &&) = delete;
+    TextureArray &operator=(TextureArray &&) = delete;
+
+    TextureArray(const tstring &name, GLsizei width, GLsizei height, GLsizei layers);
+    ~TextureArray();
+
+    static std::unique_ptr<TextureArray> Create(const tstring &name, GLsizei width, GLsizei height, GLsizei layers);
+
+    // The content of the layers kept is copied to the new storage, throws above GL_MAX_ARRAY_TEXTURE_LAYERS
+    void Resize(GLsizei layers);
+
+    std::vector<uint32_t> ReadPixels(GLint layer) const;
+    // Read back only a part of the layer, rows are tightly packed
+    std::vector<uint32_t> ReadPixels(GLint layer, glm::ivec2 offset, glm::ivec2 size) const;
+    void SetPixels(GLint layer, std::span<const uint32_t> pixels);
+    void Fill(GLint layer, uint32_t color);
+
+    void Bind(GLuint unit) const noexcept;
+
+    GLuint ID() const noexcept;
+    GLsizei Width() const noexcept;
+    GLsizei Height() const noexcept;
+    GLsizei Layers() const noexcept;
+
+  private:
+    static GLuint CreateStorage(const std::string &name, GLsizei width, GLsizei height, GLsizei layers);
+
+    std::string _name;
+    GLuint _ID;
+    GLsizei _width;
+    GLsizei _height;
+    GLsizei _layers;
+};
+
+// Pixel buffer a texture is copied into without waiting for the GPU, the copy is complete once its fence is signaled
+class Readback {
+  public:
+    Readback(const Readback &) = delete;
+    Readback &operator=(const Readback &) = delete;
+    Readback(Readback &&) = delete;
+    Readback &operator=(Readback &&) = delete;
+
+    Readback(const tstring &name, GLsizeiptr size);
+    ~Readback();
+
+    static std::unique_ptr<Readback> Create(const tstring &name, GLsizeiptr size);
+
+    void Request(const TextureArray &texture, GLint layer);
+    bool IsPending() const noexcept;
+    // Never blocks, true once the copy requested is done
+    bool IsReady() const;
+    // Wait for the copy if needed, the buffer can then be requested again
+    std::vector<uint32_t> Collect();
+
+  private:
+    void Release();
+
+    std::string _name;
+    GLuint _ID;
+    GLsizeiptr _size;
+    GLsync _fence;
+    const uint32_t *_data;
+};
+
+// Shader storage buffer written through a persistent mapping as a ring, a part of it is only written again
+// once the GPU is done with the commands that used it. It grows when an allocation does not fit
+class Storagebuffer {
+  public:
+    Storagebuffer(const Storagebuffer &) = delete;
+    Storagebuffer &operator=(const Storagebuffer &) = delete;
+    Storagebuffer(Storagebuffer &&) = delete;
+    Storagebuffer &operator=(Storagebuffer &&) = delete;
+
+    Storagebuffer(const tstring &name, GLuint binding, GLsizeiptr size);
+    ~Storagebuffer();
+
+    static std::unique_ptr<Storagebuffer> Create(const tstring &name, GLuint binding, GLsizeiptr size);
+
+    // size bytes to write before the next call, they are bound to the binding until then
+    void *Allocate(GLsizeiptr size);
+
+  private:
+    void Reserve(GLsizeiptr size);
+    void Release();
+
+    struct Fence {
+        GLintptr start;
+        GLintptr end;
+        GLsync sync;
+    };
+
+    std::string _name;
+    GLuint _ID;
+    GLuint _binding;
+    GLsizeiptr _size;
+    GLintptr _alignment;
+    std::uint8_t *_data;
+
+    // Allocation bound to the binding, it is fenced when the next one is made
+    GLintptr _start;
+    GLintptr _end;
+    std::deque<Fence> _fences;
+};
+
 class Mesh {
   public:
     using Element = std::uint32_t;
@@ -90,6 +201,8 @@ class Mesh {
     static std::unique_ptr<Mesh> Create(const tstring &name);
 
     void Render(GLenum mode, GLsizei count);
+    // Draws count vertices per instance without any vertex buffer, instances read their data from gl_InstanceID
+    void RenderInstanced(GLenum mode, GLsizei count, GLsizei instances);
 
   private:
     void Release();
@@ -129,6 +242,7 @@ class Program {
     void SetInt(const std::string &name, std::int32_t value);
     void SetUint(const std::string &name, std::uint32_t value);
     void SetVec2(const std::string &name, glm::vec2 value);
+    void SetIVec2(const std::string &name, glm::ivec2 value);
     void SetVec3(const std::string &name, glm::vec3 value);
     void SetVec4(const std::string &name, glm::vec4 value);
     void SetMat4(const std::string &name, glm::mat4 &value);
@@ -160,6 +274,11 @@ class Framebuffer {
     void Unbind();
     void Render();
 
+    GLsizei Width() const noexcept;
+    GLsizei Height() const noexcept;
+    // Last frame rendered in it, rows bottom to top
+    std::vector<uint32_t> ReadPixels() const;
+
   private:
 
     void Release();
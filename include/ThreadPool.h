@@ -0,0 +1,51 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of tasks
+class ThreadPool {
+  public:
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    ThreadPool(size_t thread_count);
+    ~ThreadPool();
+
+    // thread_count 0 uses every hardware thread
+    static std::unique_ptr<ThreadPool> Create(size_t thread_count);
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Submit(F &&task) {
+        using Result = std::invoke_result_t<F>;
+
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        auto future = packaged->get_future();
+        {
+            std::scoped_lock lock(_mutex);
+            _tasks.emplace([packaged]() { (*packaged)(); });
+        }
+        _condition.notify_one();
+
+        return future;
+    }
+
+    size_t Size() const noexcept;
+
+  private:
+    void Work();
+
+    std::vector<std::thread> _threads;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _stop;
+};
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Position of each tile in the parallel arrays of its owner, by tile coord
+// Open addressing with linear probing on the packed coord, a lookup is usually a single cache line
+class TileIndex {
+  public:
+    TileIndex();
+
+    std::optional<size_t> Find(int x, int y) const;
+    bool Contains(int x, int y) const;
+    // Does nothing and returns false when the tile is already indexed
+    bool Insert(int x, int y, size_t index);
+    void Erase(int x, int y);
+    void Clear();
+
+    size_t Size() const noexcept;
+    // In the order of the slots, the callers that need an order sort it themselves
+    std::vector<std::pair<int, int>> GetCoords() const;
+
+  private:
+    static constexpr size_t empty = SIZE_MAX;
+
+    struct Slot {
+        std::uint64_t key;
+        size_t index = empty;
+    };
+
+    static std::uint64_t Pack(int x, int y) noexcept;
+    size_t GetSlot(std::uint64_t key) const noexcept;
+    // Slot of the key, or the empty slot where it would be inserted
+    size_t Probe(std::uint64_t key) const noexcept;
+    void Rehash(size_t capacity);
+
+    std::vector<Slot> _slots;
+    size_t _size;
+};
\ No newline at end of file
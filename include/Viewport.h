@@ -1,6 +1,5 @@
 #pragma once
 
-#include "Renderer.h"
 #include "AABB.h"
 #include <glm/vec2.hpp>
 #include <glm/mat4x4.hpp>
@@ -20,26 +19,34 @@ public:
 	float GetRotation() const noexcept;
 	float GetZoom() const noexcept;
 
-	bool IsVisible(AABB other);
+	// Inclusive range of the tile coords under the viewport
+	struct TileRange {
+		glm::ivec2 first;
+		glm::ivec2 last;
+	};
+
+	bool IsVisible(AABB other) const noexcept;
+	// Canvas area under the viewport with its position, rotation and zoom
+	AABB GetBounds() const noexcept;
+	TileRange GetTileRange(int tile_resolution) const noexcept;
 
 	void UpdateViewMatrix();
 	void UpdateProjMatrix();
 
+	// Uploaded to the viewport uniformbuffer by the app before rendering
 	struct Matrices {
 		glm::mat4 view;
 		glm::mat4 proj;
 	} _matrices;
 
 private:
-	std::unique_ptr<Uniformbuffer> _buffer;
-	
 	glm::vec2 _position;
 	float _rotation;
 	float _zoom;
 
 	glm::ivec2 _size;
-	glm::ivec2 _corner;
 	AABB _aabb;
 
+	void UpdateBounds();
 };
 
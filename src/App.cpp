@@ -3,6 +3,7 @@
 #include "Resource.h"
 
 #include <ShObjIdl.h>
+#include <algorithm>
 
 int App::nOpenContexts = 0;
 int App::nAttachedDevices = 0;
@@ -92,6 +93,8 @@ App::App(HINSTANCE instance, int show_cmd) : _instance(instance), _show_cmd(show
     Log::Info(TEXT("Mashiro starting"));
 
     _preferences = std::make_unique<Preferences>();
+    // A negative size would wrap around to a huge thread count, it falls back on every hardware thread
+    _thread_pool = ThreadPool::Create(static_cast<size_t>(std::max(_preferences->_thread_pool_size, 0)));
 
     if (!LoadWintab()) {
         throw std::runtime_error("Failed to initialize wintab.dll");
@@ -403,6 +406,8 @@ void App::Init(HWND hwnd) {
     glEnable(GL_BLEND);
 
     _viewport = std::make_unique<Viewport>(glm::ivec2(800, 600));
+    _viewport_uniformbuffer =
+        Uniformbuffer::Create(TEXT("Viewport Matrices"), 0, sizeof(Viewport::Matrices), nullptr);
 
     //_app_uniformbuffer = Uniformbuffer::Create(TEXT("App Uniformbuffer"), 0, 0, nullptr);
 
@@ -438,6 +443,8 @@ void App::Render() {
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    _viewport_uniformbuffer->SetData(0, sizeof(Viewport::Matrices), &_viewport->_matrices);
+
     if (_canvas) {
         _canvas->Render(_viewport.get());
     }
@@ -567,10 +574,11 @@ bool App::Save() {
         return true;
     }
 
+    SavePreview();
     _canvas->Save(_file.get());
     _file->Save(_file->GetFilename());
 
-    SetWindowText(_window->Hwnd(), _file->GetDisplayName().c_str());
+    SetWindowText(_window->Hwnd(), GetDisplayName().c_str());
     return true;
 }
 
@@ -591,13 +599,27 @@ bool App::SaveAs() {
     }
 
     _file->Rename(path.value().filename());
+    SavePreview();
     _canvas->Save(_file.get());
     _file->Save(path.value());
 
-    SetWindowText(_window->Hwnd(), _file->GetDisplayName().c_str());
+    SetWindowText(_window->Hwnd(), GetDisplayName().c_str());
     return true;
 }
 
+void App::SavePreview() {
+    auto pixels = _framebuffer->ReadPixels();
+    const auto width = _framebuffer->Width();
+    const auto height = _framebuffer->Height();
+    for (int y = 0; y < height / 2; y++) {
+        std::swap_ranges(pixels.begin() + y * width, pixels.begin() + (y + 1) * width,
+                         pixels.begin() + (height - 1 - y) * width);
+    }
+
+    _file->SetPreview(File::CreatePreview(_viewport->GetPosition(), _viewport->GetZoom(), _viewport->GetRotation(),
+                                          pixels, width, height));
+}
+
 bool App::Open() {
     if (_file) {
         if (!_file->IsSaved() || !_canvas->IsSaved()) {
@@ -625,15 +647,26 @@ bool App::Open() {
     _canvas.release();
     _file.release();
 
-    _file = File::Open(path.value());
-    _canvas = Canvas::Open(_file.get());
-
-    SetWindowText(_window->Hwnd(), _file->GetDisplayName().c_str());
+    OpenFile(path.value());
 
     _window->Render();
     return true;
 }
 
+void App::OpenFile(std::filesystem::path filename) {
+    _file = File::Open(filename);
+    _canvas = Canvas::Open(_file.get());
+
+    // The first frame then streams the tiles of the saved view before any other
+    if (const auto preview = _file->GetPreview()) {
+        _viewport->SetPosition(preview->position, false);
+        _viewport->SetZoom(preview->zoom, false);
+        _viewport->SetRotation(preview->rotation);
+    }
+
+    SetWindowText(_window->Hwnd(), GetDisplayName().c_str());
+}
+
 bool App::New() {
     if (_file) {
         if (!_file->IsSaved() || !_canvas->IsSaved()) {
@@ -660,16 +693,24 @@ bool App::New() {
     _canvas.release();
     _file.release();
 
-    _file = File::New("unnamed.msh");
+    _file = File::New("unnamed.msh", _preferences->_tile_resolution);
     _canvas = Canvas::Open(_file.get());
 
-    SetWindowText(_window->Hwnd(), _file->GetDisplayName().c_str());
+    SetWindowText(_window->Hwnd(), GetDisplayName().c_str());
 
     _window->Render();
 
     return true;
 }
 
+tstring App::GetDisplayName() const {
+    if (!_file->IsSaved() || !_canvas->IsSaved()) {
+        return std::format(TEXT("*{}"), _file->GetFilename().filename().wstring());
+    }
+    // FIXME: This and all the other call using .wstring() will break ansi compatibility
+    return _file->GetFilename().filename().wstring();
+}
+
 void App::Exit() {
     if (_file) {
         if (!_file->IsSaved() || !_canvas->IsSaved()) {
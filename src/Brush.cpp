@@ -1,15 +1,20 @@
+#include "App.h"
 #include "Canvas.h"
+#include "Preferences.h"
+#include "Rasterizer.h"
 #include "Viewport.h"
 
+#include <cstring>
 #include <vector>
+#include <glm/common.hpp>
 #include <glm/geometric.hpp>
 
 
 std::unique_ptr<Program> Brush::_program;
 std::unique_ptr<Mesh> Brush::_mesh;
 std::unique_ptr<Uniformbuffer> Brush::_brush_ubo;
-std::unique_ptr<Uniformbuffer> Brush::_brush_compute_ubo;
-std::uint32_t Brush::_brush_ubo_size;
+std::unique_ptr<Storagebuffer> Brush::_brush_storage;
+std::unique_ptr<Storagebuffer> Brush::_tiles_storage;
 
 void Brush::Init() {
 	_program = Program::Create(TEXT("Brush Program"));
@@ -19,11 +24,11 @@ void Brush::Init() {
 
 	_mesh = Mesh::Create(TEXT("Brush Mesh"));
 	_brush_ubo = Uniformbuffer::Create(TEXT("Brush Display Uniformbuffer"), 2, sizeof(BrushData), nullptr);
-	_brush_compute_ubo = Uniformbuffer::Create(TEXT("Brush Compute Uniformbuffer"), 3, sizeof(BrushData) * 64, nullptr);
-	_brush_ubo_size = 0;
+	_brush_storage = Storagebuffer::Create(TEXT("Brush Dabs Storagebuffer"), 3, sizeof(BrushData) * 4096);
+	_tiles_storage = Storagebuffer::Create(TEXT("Brush Tiles Storagebuffer"), 4, sizeof(BrushTile) * 256);
 }
 
-Brush::Brush() {
+Brush::Brush() : _brush_data(), _bounds(Dab::GetBounds({})) {
 	_compute_program = Program::Create(TEXT("Brush Compute"));
 	_compute_program->AddShader("data/brush.comp", GL_COMPUTE_SHADER);
 	_compute_program->Compile();
@@ -36,74 +41,79 @@ Brush::Brush() {
 }
 
 void Brush::SetBrushData(BrushData data) {
-	_brush_ubo_size = 1;
-	_brush_data = data;
-	_brush_ubo->SetData(0, sizeof(BrushData), &_brush_data);
-	_brush_compute_ubo->SetData(0, sizeof(BrushData) * _brush_ubo_size, &data);
+	SetBrushDatas({&data, 1});
 }
 
-void Brush::SetBrushDatas(std::span<BrushData> data) {
-	_brush_ubo_size = std::min((size_t)64, data.size());
-	_brush_data = data[_brush_ubo_size - 1];
-	_brush_compute_ubo->SetData(0, sizeof(BrushData) * _brush_ubo_size, data.data());
-	_brush_ubo->SetData(0, sizeof(BrushData), &data[_brush_ubo_size - 1]);
+void Brush::SetBrushDatas(std::span<const BrushData> data) {
+	if (data.empty()) {
+		return;
+	}
+
+	_brush_data = data.back();
+	_bounds = Dab::GetBounds(data);
+	_brush_datas.assign(data.begin(), data.end());
+	_brush_ubo->SetData(0, sizeof(BrushData), &_brush_data);
+
+	// Laid out like the Data block of brush.comp, the dabs start at the 16 bytes alignment of BrushData in std430
+	constexpr size_t dabs_offset = 16;
+	auto buffer = static_cast<std::uint8_t*>(_brush_storage->Allocate(dabs_offset + data.size_bytes()));
+	const auto count = static_cast<std::uint32_t>(data.size());
+	std::memcpy(buffer, &count, sizeof(count));
+	std::memcpy(buffer + dabs_offset, data.data(), data.size_bytes());
 }
 
 Brush::BrushData Brush::GetBrushData() {
 	return _brush_data;
 }
 
-void Brush::Paint(Texture* texture) {
-	_compute_program->Bind();
-	_compute_program->SetUint("brush_datas_count", _brush_ubo_size);
-	glBindImageTexture(0, texture->ID(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
-	glDispatchCompute(texture->Width() / _program_work_group_size.x,
-					  texture->Height() / _program_work_group_size.y, 1);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+AABB Brush::GetBounds() const {
+	return _bounds;
 }
 
-void Brush::PaintLine(Canvas* canvas, BrushData start, BrushData end, float step) {
-	auto len = glm::distance(start.position, end.position);
-	size_t step_count = std::ceil(len / step);
-
-	std::vector<BrushData> datas;
-	datas.reserve(64);
-
-	_brush_data = start;
-	float progress = 0.0f;
-	for (size_t t = 0; t < step_count; t++) {
-		if (t == 0) {
-			_brush_data = start;
-		} else if (t == step_count - 1) {
-			_brush_data = end;
-		} else {
-			_brush_data.color = glm::mix(start.color, end.color, progress);
-			_brush_data.position = glm::mix(start.position, end.position, progress);
-			_brush_data.pressure = std::lerp(start.pressure, end.pressure, progress);
-			_brush_data.tilt = std::lerp(start.tilt, end.tilt, progress);
-			_brush_data.orientation = std::lerp(start.orientation, end.orientation, progress);
-			_brush_data.rotation = std::lerp(start.rotation, end.rotation, progress);
+void Brush::Paint(TextureArray* tiles, std::span<const BrushTile> parts) {
+	if (parts.empty()) {
+		return;
+	}
+
+	if (Preferences::Get()->_brush_cpu) {
+		for (const auto& part : parts) {
+			auto pixels = tiles->ReadPixels(part.layer);
+			Rasterizer::Paint(_brush_datas, part.coord, tiles->Width(), pixels);
+			tiles->SetPixels(part.layer, pixels);
 		}
+		return;
+	}
 
-		datas.push_back(_brush_data);
+	glm::ivec2 size = {0, 0};
+	for (const auto& part : parts) {
+		size = glm::max(size, part.size);
+	}
+	auto buffer = _tiles_storage->Allocate(parts.size_bytes());
+	std::memcpy(buffer, parts.data(), parts.size_bytes());
 
-		if (datas.size() > 64) {
-			SetBrushDatas(datas);
-			canvas->Paint(this);
-			datas.clear();
-		} else if (t == step_count - 1 && !datas.empty()) {
-			SetBrushDatas(datas);
-			canvas->Paint(this);
-			datas.clear();
-		}
+	// One work group layer per tile, the groups past the size of their tile return right away
+	_compute_program->Bind();
+	glBindImageTexture(0, tiles->ID(), 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+	glDispatchCompute((size.x + _program_work_group_size.x - 1) / _program_work_group_size.x,
+					  (size.y + _program_work_group_size.y - 1) / _program_work_group_size.y,
+					  static_cast<GLuint>(parts.size()));
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
 
-		progress += 1.0 / (float)step_count;
+void Brush::PaintLine(Canvas* canvas, BrushData start, BrushData end, float step) {
+	auto datas = Dab::Interpolate(start, end, step);
+
+	if (datas.empty()) {
+		return;
 	}
+
+	SetBrushDatas(datas);
+	canvas->Paint(this);
 }
 
 void Brush::Paint(Canvas* canvas, BrushData data) {
 	SetBrushData(data);
-	canvas->LazyLoad(_brush_data.position, nullptr);
+	canvas->LazyLoad(_brush_data.position, App::Get()->_file.get());
 	canvas->Paint(this);
 }
 
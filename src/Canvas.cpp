@@ -4,19 +4,27 @@
 #include "Preferences.h"
 #include "Viewport.h"
 
+#include <algorithm>
+#include <chrono>
+
 std::vector<uint32_t> Canvas::_pixels;
-std::unique_ptr<Uniformbuffer> Canvas::_tile_ubo;
+std::unique_ptr<Storagebuffer> Canvas::_tile_instances;
 std::unique_ptr<Program> Canvas::_program;
+std::unique_ptr<Program> Canvas::_downsample_program;
 std::unique_ptr<Mesh> Canvas::_mesh;
 
 void Canvas::Init() {
-    _tile_ubo = Uniformbuffer::Create(TEXT("Tile Uniformbuffer"), 1, sizeof(Tile), nullptr);
+    _tile_instances = Storagebuffer::Create(TEXT("Tile Instances Storagebuffer"), 1, sizeof(Tile) * 4096);
 
     _program = Program::Create(TEXT("Tile Uniformbuffer"));
     _program->AddShader("data/tile.vert", GL_VERTEX_SHADER);
     _program->AddShader("data/tile.frag", GL_FRAGMENT_SHADER);
     _program->Compile();
 
+    _downsample_program = Program::Create(TEXT("Tile Downsample"));
+    _downsample_program->AddShader("data/downsample.comp", GL_COMPUTE_SHADER);
+    _downsample_program->Compile();
+
     const auto tile_resolution = Preferences::Get()->_tile_resolution;
     const auto tile_color = Preferences::Get()->_tile_default_color;
 
@@ -25,7 +33,9 @@ void Canvas::Init() {
     _mesh = Mesh::Create(TEXT("Tile Uniformbuffer"));
 }
 
-Canvas::Canvas() {
+Canvas::Canvas() : _frame(0), _levels(Pyramid::max_level), _level(0), _layers_used(0), _saved(false) {
+    const auto resolution = Preferences::Get()->_tile_resolution;
+    _tiles_pool = TextureArray::Create(TEXT("Tile Pool"), resolution, resolution, 64);
 }
 
 Canvas::~Canvas() {
@@ -38,27 +48,26 @@ std::unique_ptr<Canvas> Canvas::New() {
 }
 
 void Canvas::Load(glm::ivec2 coord, File *file) {
-    if (_coord_tile.contains({coord.x, coord.y})) {
+    if (const auto index = _coord_tile.Find(coord.x, coord.y)) {
+        if (!IsResident(index.value())) {
+            RestoreTile(index.value(), file);
+        }
         return;
     }
 
     CreateTile(coord);
-    if (file) {
-        auto pixels = file->ReadTileTexture(coord.x, coord.y);
-        _tiles_textures[_coord_tile[{coord.x, coord.y}]].SetPixels(pixels);
-    } else {
-        _tiles_textures[_coord_tile[{coord.x, coord.y}]].SetPixels(_pixels);
-    }
+    FillTile(_coord_tile.Find(coord.x, coord.y).value(), file);
 }
 
 std::unique_ptr<Canvas> Canvas::Open(File *file) {
     auto canvas = std::make_unique<Canvas>();
+    canvas->_saved = true;
 
     for (const auto &[x, y] : file->GetSavedTileLocation()) {
-        canvas->Load({x, y}, file);
+        canvas->_coverage.AddTile({x, y});
     }
 
-    canvas->_saved = true;
+    Log::Info(std::format(TEXT("Opened a canvas of {} tiles"), file->GetSavedTileCount()));
 
     return canvas;
 }
@@ -68,12 +77,39 @@ bool Canvas::IsSaved() const {
 }
 
 void Canvas::Save(File *file) {
-    for (size_t i = 0; i < _tiles_saved.size(); i++) {
-        if (!_tiles_saved[i]) {
-            SaveTile(i, file);
+    UpdatePyramid(file);
+
+    // Readbacks still in flight are older than the tiles dirty now, they are written first
+    std::vector<File::TileTexture> tiles;
+    for (auto &pending : _readbacks) {
+        tiles.push_back({pending.coord.x, pending.coord.y, pending.readback->Collect(), pending.lod});
+        _readbacks_free.push_back(std::move(pending.readback));
+    }
+    _readbacks.clear();
+
+    for (size_t i = 0; i < _tiles_dirty.size(); i++) {
+        if (!_tiles_dirty[i].IsEmpty()) {
+            tiles.push_back(ReadTile(i));
+        }
+    }
+
+    for (int level = 1; level <= Pyramid::max_level; level++) {
+        auto &parents = _levels[level - 1];
+        for (size_t i = 0; i < parents.tiles.size(); i++) {
+            const auto &tile = parents.tiles[i];
+            if (parents.dirty[i] && _coverage.IsComplete(level, tile.coord)) {
+                tiles.push_back({tile.coord.x, tile.coord.y, _tiles_pool->ReadPixels(tile.layer), level});
+                parents.dirty[i] = false;
+            }
         }
     }
 
+    const auto preferences = Preferences::Get();
+    const auto pool = App::Get()->_thread_pool.get();
+    file->WriteTileTextures(std::move(tiles), pool, preferences->_save_codec, preferences->_save_codec_level);
+    // The lazy saves committed most of the tiles with their faster codec
+    file->RecodeTileTextures(pool, preferences->_save_codec, preferences->_save_codec_level);
+
     _saved = true;
 }
 
@@ -90,69 +126,161 @@ void Canvas::LazyLoad(glm::vec2 cursor, File *file) {
 }
 
 void Canvas::LazySave(glm::vec2 cursor, File *file) {
-    // if the cursor is not visited from a long time
-    const auto max_save = Preferences::Get()->_lazy_save_count;
+    const auto preferences = Preferences::Get();
+    const auto pool = App::Get()->_thread_pool.get();
+
+    // Readbacks requested on the previous frames go to the encoders once the GPU is done with them
+    std::vector<File::TileTexture> tiles;
+    for (auto pending = _readbacks.begin(); pending != _readbacks.end();) {
+        if (pending->readback->IsReady()) {
+            tiles.push_back({pending->coord.x, pending->coord.y, pending->readback->Collect(), pending->lod});
+            _readbacks_free.push_back(std::move(pending->readback));
+            pending = _readbacks.erase(pending);
+        } else {
+            pending++;
+        }
+    }
 
-    int save_counter = 0;
-    for (size_t i = 0; i < _tiles_saved.size(); i++) {
-        if (!_tiles_saved[i] && !_tiles_processing[i] && !_tiles_visibility[i]) {
-            // SaveTile function
-            SaveTile(i, file);
-            save_counter++;
-            if (save_counter >= max_save) {
-                break;
-            }
+    if (!tiles.empty()) {
+        file->QueueTileTextures(std::move(tiles), pool, preferences->_lazy_save_codec,
+                                preferences->_lazy_save_codec_level);
+    }
+    file->CommitTileTextures(false);
 
-            // When all the tiles have been saved mark the file as saved
-            if (i == _tiles_saved.size() - 1) {
-                _saved = true;
+    // if the cursor is not visited from a long time
+    const auto max_save = static_cast<size_t>(preferences->_lazy_save_count);
+    for (size_t i = 0; i < _tiles_dirty.size() && _readbacks.size() < max_save; i++) {
+        if (!_tiles_dirty[i].IsEmpty() && !_tiles_processing[i] && !_tiles_visibility[i]) {
+            RequestReadback(i);
+        }
+    }
+
+    // The pyramid changes with every stroke, it is only saved once the tiles it is built from are
+    if (std::all_of(_tiles_dirty.begin(), _tiles_dirty.end(), [](const TileRect &rect) { return rect.IsEmpty(); })) {
+        for (int level = 1; level <= Pyramid::max_level && _readbacks.size() < max_save; level++) {
+            auto &parents = _levels[level - 1];
+            for (size_t i = 0; i < parents.tiles.size() && _readbacks.size() < max_save; i++) {
+                if (parents.dirty[i] && _coverage.IsComplete(level, parents.tiles[i].coord)) {
+                    QueueReadback(parents.tiles[i], level);
+                    parents.dirty[i] = false;
+                }
             }
         }
     }
+
+    EvictTiles(file);
+
+    // When all the tiles have been read back mark the canvas as saved
+    if (_readbacks.empty() &&
+        std::all_of(_tiles_dirty.begin(), _tiles_dirty.end(), [](const TileRect &rect) { return rect.IsEmpty(); })) {
+        _saved = true;
+    }
 }
 
 void Canvas::SaveTile(size_t i, File *file) {
+    auto tile = ReadTile(i);
+    file->WriteTileTexture(tile.x, tile.y, std::move(tile.pixels), Preferences::Get()->_save_codec,
+                           Preferences::Get()->_save_codec_level);
+}
+
+void Canvas::RequestReadback(size_t i) {
+    QueueReadback(_tiles_data[i], 0);
+    _tiles_dirty[i] = TileRect();
+}
+
+void Canvas::QueueReadback(const Tile &tile, int lod) {
+    std::unique_ptr<Readback> readback;
+    if (_readbacks_free.empty()) {
+        const auto resolution = Preferences::Get()->_tile_resolution;
+        readback = Readback::Create(TEXT("Tile Readback"), resolution * resolution * sizeof(uint32_t));
+    } else {
+        readback = std::move(_readbacks_free.back());
+        _readbacks_free.pop_back();
+    }
+
+    readback->Request(*_tiles_pool, tile.layer);
+    _readbacks.push_back({tile.coord, lod, std::move(readback)});
+}
+
+File::TileTexture Canvas::ReadTile(size_t i) {
     const auto x = _tiles_data[i].coord.x;
     const auto y = _tiles_data[i].coord.y;
-    auto pixels = _tiles_textures[i].ReadPixels();
+    auto pixels = _tiles_pool->ReadPixels(_tiles_data[i].layer);
 
-    file->WriteTileTexture(x, y, pixels);
+    _tiles_dirty[i] = TileRect();
 
-    _tiles_saved[i] = true;
+    return File::TileTexture{x, y, std::move(pixels)};
 }
 
 void Canvas::Refresh() {
     _program->Compile();
+    _downsample_program->Compile();
 }
 
 void Canvas::Paint(Brush *brush) {
     const auto tile_resolution = Preferences::Get()->_tile_resolution;
-    const glm::ivec2 coord = glm::floor(brush->GetPosition() / glm::vec2(tile_resolution));
 
-    for (int y = -1; y < 2; y++) {
-        for (int x = -1; x < 2; x++) {
-            Load({coord.x + x, coord.y + y}, nullptr);
-            const auto index = _coord_tile[{coord.x + x, coord.y + y}];
-            _tiles_processing[index] = true;
-            _tile_ubo->SetData(0, sizeof(Tile), &_tiles_data[index]);
-            brush->Paint(&_tiles_textures[index]);
-            _tiles_processing[index] = false;
-            _tiles_saved[index] = false;
+    // Only the tiles under the footprint of the dabs are painted and marked as dirty
+    const auto bounds = brush->GetBounds();
+    if (bounds.min.x > bounds.max.x || bounds.min.y > bounds.max.y) {
+        return;
+    }
+    const glm::ivec2 min = glm::floor(bounds.min);
+    const glm::ivec2 max = glm::ivec2(glm::floor(bounds.max)) + 1;
+    const glm::ivec2 first = glm::floor(glm::vec2(min) / glm::vec2(tile_resolution));
+    const glm::ivec2 last = glm::floor(glm::vec2(max - 1) / glm::vec2(tile_resolution));
+
+    // Every tile under the dabs is painted by the same dispatch, only over the part of it under the dabs
+    std::vector<Brush::BrushTile> parts;
+    std::vector<size_t> indexes;
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++) {
+            const glm::ivec2 origin = glm::ivec2(x, y) * tile_resolution;
+            const TileRect rect = {glm::clamp(min - origin, 0, tile_resolution),
+                                   glm::clamp(max - origin, 0, tile_resolution)};
+            if (rect.IsEmpty()) {
+                continue;
+            }
+
+            Load({x, y}, App::Get()->_file.get());
+            const auto index = _coord_tile.Find(x, y).value();
+            parts.push_back({{x, y}, rect.min, rect.max - rect.min, _tiles_data[index].layer, 0});
+            indexes.push_back(index);
+
+            _tiles_dirty[index] = _tiles_dirty[index].Union(rect);
+            MarkStale(index);
         }
     }
 
-    // Consider optimizing this to avoid needless save when no data was written
+    for (const auto index : indexes) {
+        _tiles_processing[index] = true;
+    }
+    brush->Paint(_tiles_pool.get(), parts);
+    for (const auto index : indexes) {
+        _tiles_processing[index] = false;
+    }
+
     _saved = false;
-    SetWindowText(App::Get()->_window->Hwnd(), App::Get()->_file->GetDisplayName().c_str());
+    SetWindowText(App::Get()->_window->Hwnd(), App::Get()->GetDisplayName().c_str());
 }
 
 void Canvas::Render(Viewport *viewport) {
-    CullTiles(viewport);
+    const auto file = App::Get()->_file.get();
+    const auto level = Pyramid::GetLevel(viewport->GetZoom());
+    if (level == 0) {
+        StreamTiles(viewport, file);
+        PrefetchTiles(viewport, file);
+    } else {
+        BuildPyramid(viewport, file, level);
+    }
+
+    UpdatePyramid(file);
+    CullTiles(viewport, level);
     RenderTiles();
 }
 
 void Canvas::CreateTile(glm::ivec2 coord) {
-    if (_coord_tile.contains({coord.x, coord.y})) {
+    if (_coord_tile.Contains(coord.x, coord.y)) {
         Log::Trace(std::format(TEXT("Tile ({},{}) is already created"), coord.x, coord.y));
         return;
     }
@@ -161,35 +289,58 @@ void Canvas::CreateTile(glm::ivec2 coord) {
 
     size_t index = _tiles_data.size();
 
-    _coord_tile.emplace(std::pair<int, int>(coord.x, coord.y), index);
-    _tiles_data.push_back(Tile(coord, 0, resolution));
-    _tiles_aabb.push_back(AABB({0.0f, 0.0f}, {1.0f, 1.0f}));
+    _coord_tile.Insert(coord.x, coord.y, index);
+    _tiles_data.push_back(Tile(coord, AllocateLayer(), resolution));
+    _tiles_aabb.push_back(AABB(glm::vec2(coord * resolution), glm::vec2((coord + 1) * resolution)));
     _tiles_visibility.push_back(false);
-    _tiles_saved.push_back(false);
+    _tiles_dirty.push_back(TileRect());
     _tiles_processing.push_back(false);
-    _tiles_textures.push_back(
-        Texture(std::format(TEXT("Tile ({},{}) Texture"), coord.x, coord.y), resolution, resolution));
+    _tiles_viewed.push_back(_frame);
+    _tiles_stale.push_back(false);
+    MarkStale(index);
+    _coverage.AddTile(coord);
 
     Log::Trace(std::format(TEXT("Created Tile ({},{})"), coord.x, coord.y));
-
-    _saved = false;
 }
 
 void Canvas::DeleteTile(glm::ivec2 coord) {
-    if (!_coord_tile.contains({coord.x, coord.y})) {
+    if (!_coord_tile.Contains(coord.x, coord.y)) {
         Log::Trace(std::format(TEXT("Tile ({},{}) does not exist and thus cannot be deleted"), coord.x, coord.y));
         return;
     }
 
-    size_t index = _coord_tile[{coord.x, coord.y}];
+    const size_t index = _coord_tile.Find(coord.x, coord.y).value();
+    if (IsResident(index)) {
+        _layers_free.push_back(_tiles_data[index].layer);
+    }
 
-    _tiles_data.erase(_tiles_data.begin() + index);
-    _tiles_aabb.erase(_tiles_aabb.begin() + index);
-    _tiles_visibility.erase(_tiles_visibility.begin() + index);
-    _tiles_saved.erase(_tiles_saved.begin() + index);
-    _tiles_textures.erase(_tiles_textures.begin() + index);
-    _tiles_processing.erase(_tiles_processing.begin() + index);
-    _coord_tile.erase({coord.x, coord.y});
+    // The last tile takes the place of the deleted one so only its index changes
+    const size_t last = _tiles_data.size() - 1;
+    _coord_tile.Erase(coord.x, coord.y);
+    if (index != last) {
+        const auto moved = _tiles_data[last].coord;
+        _coord_tile.Erase(moved.x, moved.y);
+        _coord_tile.Insert(moved.x, moved.y, index);
+
+        _tiles_data[index] = _tiles_data[last];
+        _tiles_aabb[index] = _tiles_aabb[last];
+        _tiles_visibility[index] = _tiles_visibility[last];
+        _tiles_dirty[index] = _tiles_dirty[last];
+        _tiles_processing[index] = _tiles_processing[last];
+        _tiles_viewed[index] = _tiles_viewed[last];
+        _tiles_stale[index] = _tiles_stale[last];
+    }
+    _tiles_data.pop_back();
+    _tiles_aabb.pop_back();
+    _tiles_visibility.pop_back();
+    _tiles_dirty.pop_back();
+    _tiles_processing.pop_back();
+    _tiles_viewed.pop_back();
+    _tiles_stale.pop_back();
+
+    // The visible indexes may refer to the moved tile, they are all culled again on the next frame
+    std::fill(_tiles_visibility.begin(), _tiles_visibility.end(), false);
+    _tiles_visible.clear();
 
     Log::Trace(std::format(TEXT("Deleted Tile ({},{})"), coord.x, coord.y));
 
@@ -200,19 +351,586 @@ void Canvas::ReloadTile(glm::ivec2 coord) {
     // ?? what do i do here ???
 }
 
-void Canvas::RenderTiles() {
-    _program->Bind();
+bool Canvas::IsResident(size_t i) const {
+    return _tiles_data[i].layer != no_layer;
+}
+
+std::uint32_t Canvas::AllocateLayer() {
+    if (!_layers_free.empty()) {
+        const auto layer = _layers_free.back();
+        _layers_free.pop_back();
+        return layer;
+    }
+
+    if (_layers_used == static_cast<std::uint32_t>(_tiles_pool->Layers())) {
+        _tiles_pool->Resize(_tiles_pool->Layers() * 2);
+    }
+    return _layers_used++;
+}
+
+void Canvas::FillTile(size_t i, File *file) {
+    const auto coord = _tiles_data[i].coord;
+    const auto layer = _tiles_data[i].layer;
+    if (file && file->HasTile(coord.x, coord.y)) {
+        if (const auto color = file->GetTileColor(coord.x, coord.y)) {
+            _tiles_pool->Fill(layer, color.value());
+        } else {
+            _tiles_pool->SetPixels(layer, file->ReadTileTexture(coord.x, coord.y));
+        }
+    } else {
+        _tiles_pool->SetPixels(layer, _pixels);
+    }
+}
+
+void Canvas::RestoreTile(size_t i, File *file) {
+    // Only saved tiles are evicted so the file has the same pixels, or the tile was never painted
+    _tiles_data[i].layer = AllocateLayer();
+    FillTile(i, file);
+
+    Log::Trace(std::format(TEXT("Restored Tile ({},{})"), _tiles_data[i].coord.x, _tiles_data[i].coord.y));
+}
+
+void Canvas::StreamTiles(Viewport *viewport, File *file) {
+    const auto preferences = Preferences::Get();
+    const auto resolution = preferences->_tile_resolution;
+
+    const auto range = viewport->GetTileRange(resolution);
+    if (range.first.x > range.last.x || range.first.y > range.last.y) {
+        return;
+    }
+    const glm::ivec2 margin(preferences->_tile_stream_margin);
+    const glm::ivec2 first = range.first - margin;
+    const glm::ivec2 last = range.last + margin;
+    const auto in_range = [&first, &last](int x, int y) {
+        return x >= first.x && y >= first.y && x <= last.x && y <= last.y;
+    };
+
+    // Tiles in the file that were never loaded, and the evicted tiles
+    const auto missing = [this, file](int x, int y) {
+        if (const auto index = _coord_tile.Find(x, y)) {
+            return !IsResident(index.value());
+        }
+        return file && file->HasTile(x, y);
+    };
+
+    // Same as CullTiles, the known tiles are tested instead of the coords when there are fewer of them
+    std::vector<glm::ivec2> coords;
+    const auto count = static_cast<std::int64_t>(last.x - first.x + 1) * (last.y - first.y + 1);
+    const auto known = _tiles_data.size() + (file ? file->GetSavedTileCount() : 0);
+    if (count > static_cast<std::int64_t>(known)) {
+        if (file) {
+            for (const auto &[x, y] : file->GetSavedTileLocation()) {
+                if (in_range(x, y) && missing(x, y)) {
+                    coords.push_back({x, y});
+                }
+            }
+        }
+        for (size_t i = 0; i < _tiles_data.size(); i++) {
+            const auto coord = _tiles_data[i].coord;
+            if (!IsResident(i) && in_range(coord.x, coord.y) && !(file && file->HasTile(coord.x, coord.y))) {
+                coords.push_back(coord);
+            }
+        }
+    } else {
+        for (int y = first.y; y <= last.y; y++) {
+            for (int x = first.x; x <= last.x; x++) {
+                if (missing(x, y)) {
+                    coords.push_back({x, y});
+                }
+            }
+        }
+    }
+    if (coords.empty()) {
+        return;
+    }
+
+    const auto bounds = viewport->GetBounds();
+    const auto center = (bounds.min + bounds.max) * 0.5f;
+    const auto distance = [center, resolution](glm::ivec2 coord) {
+        const auto offset = (glm::vec2(coord) + 0.5f) * static_cast<float>(resolution) - center;
+        return offset.x * offset.x + offset.y * offset.y;
+    };
+    std::sort(coords.begin(), coords.end(),
+              [&distance](glm::ivec2 a, glm::ivec2 b) { return distance(a) < distance(b); });
+
+    // Every visible tile is loaded before the frame is drawn, only a few of the margin ones are
+    std::vector<std::pair<int, int>> decoded;
+    int margin_count = 0;
+    for (const auto coord : coords) {
+        const bool visible = coord.x >= range.first.x && coord.y >= range.first.y && coord.x <= range.last.x &&
+                             coord.y <= range.last.y;
+        if (!visible && margin_count++ >= preferences->_tile_stream_count) {
+            continue;
+        }
+
+        // Uniform tiles and tiles that are not in the file are filled right away
+        if (!file || !file->HasTile(coord.x, coord.y) || file->GetTileColor(coord.x, coord.y)) {
+            Load(coord, file);
+        } else {
+            decoded.push_back({coord.x, coord.y});
+        }
+    }
+
+    if (decoded.empty()) {
+        return;
+    }
+
+    file->ReadTileTextures(decoded, App::Get()->_thread_pool.get(),
+                           [this](int x, int y, std::span<const uint32_t> pixels) { UploadTile({x, y}, pixels); });
+}
+
+void Canvas::PrefetchTiles(Viewport *viewport, File *file) {
+    const auto preferences = Preferences::Get();
+    const auto resolution = preferences->_tile_resolution;
+
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    _prefetcher.Update(*viewport, std::chrono::duration<double>(now).count());
+
+    // The tiles decoded since the last frame are uploaded, unless they were streamed synchronously meanwhile
+    for (auto decode = _decodes.begin(); decode != _decodes.end();) {
+        if (decode->pixels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            decode++;
+            continue;
+        }
+        try {
+            UploadTile(decode->coord, decode->pixels.get());
+        } catch (const std::exception &e) {
+            Log::Info(e.what());
+        }
+        decode = _decodes.erase(decode);
+    }
+
+    const auto budget = static_cast<size_t>(preferences->_tile_prefetch_count);
+    if (!file || _decodes.size() >= budget) {
+        return;
+    }
+
+    // Only a moving viewport is predicted somewhere else, a still one is left to the streaming margin
+    if (_prefetcher.GetVelocity() == glm::vec2(0.0f) && _prefetcher.GetZoomRate() == 0.0f) {
+        return;
+    }
+    const auto predicted = _prefetcher.Predict(*viewport, preferences->_tile_prefetch_time);
+    const auto range = predicted.GetTileRange(resolution);
+    const glm::ivec2 margin(preferences->_tile_stream_margin);
+    const glm::ivec2 first = range.first - margin;
+    const glm::ivec2 last = range.last + margin;
+
+    // A zoom out can predict a range of more tiles than the budget could ever decode, it is skipped
+    const auto count = static_cast<std::int64_t>(last.x - first.x + 1) * (last.y - first.y + 1);
+    if (first.x > last.x || first.y > last.y || count > static_cast<std::int64_t>(file->GetSavedTileCount())) {
+        return;
+    }
+
+    std::vector<glm::ivec2> coords;
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++) {
+            const auto index = _coord_tile.Find(x, y);
+            if ((index.has_value() && IsResident(index.value())) || !file->HasTile(x, y)) {
+                continue;
+            }
+            const auto pending = std::find_if(_decodes.begin(), _decodes.end(), [x, y](const PendingDecode &decode) {
+                return decode.coord == glm::ivec2(x, y);
+            });
+            if (pending == _decodes.end()) {
+                coords.push_back({x, y});
+            }
+        }
+    }
+
+    const auto bounds = predicted.GetBounds();
+    const auto center = (bounds.min + bounds.max) * 0.5f;
+    const auto distance = [center, resolution](glm::ivec2 coord) {
+        const auto offset = (glm::vec2(coord) + 0.5f) * static_cast<float>(resolution) - center;
+        return offset.x * offset.x + offset.y * offset.y;
+    };
+    std::sort(coords.begin(), coords.end(),
+              [&distance](glm::ivec2 a, glm::ivec2 b) { return distance(a) < distance(b); });
+
+    const auto pool = App::Get()->_thread_pool.get();
+    for (const auto coord : coords) {
+        if (_decodes.size() >= budget) {
+            break;
+        }
+        _decodes.push_back({coord, file->ReadTileTextureAsync(coord.x, coord.y, pool)});
+    }
+}
+
+void Canvas::UploadTile(glm::ivec2 coord, std::span<const uint32_t> pixels) {
+    if (const auto index = _coord_tile.Find(coord.x, coord.y)) {
+        if (IsResident(index.value())) {
+            return;
+        }
+        _tiles_data[index.value()].layer = AllocateLayer();
+    } else {
+        CreateTile(coord);
+    }
+
+    const auto index = _coord_tile.Find(coord.x, coord.y).value();
+    _tiles_pool->SetPixels(_tiles_data[index].layer, pixels);
+}
+
+void Canvas::EvictTiles(File *file) {
+    const auto resolution = static_cast<std::uint64_t>(Preferences::Get()->_tile_resolution);
+    const auto budget = static_cast<std::uint64_t>(Preferences::Get()->_tile_memory_budget) * 1024 * 1024;
+    const auto max_resident = static_cast<size_t>(budget / (resolution * resolution * sizeof(uint32_t)));
+
+    const size_t resident = _layers_used - _layers_free.size();
+    if (resident <= max_resident || !file) {
+        return;
+    }
+
+    // The file must hold the last pixels of a tile before it leaves the pool, which is not the case while they are
+    // still read back or encoded
+    if (!file->CommitTileTextures(false)) {
+        return;
+    }
+
+    std::vector<size_t> candidates;
     for (size_t i = 0; i < _tiles_data.size(); i++) {
-        if (_tiles_visibility[i]) {
-            _tile_ubo->SetData(0, sizeof(Tile), &_tiles_data[i]);
-            _tiles_textures[i].Bind(0);
-            _mesh->Render(GL_TRIANGLES, 6);
+        if (IsResident(i) && _tiles_dirty[i].IsEmpty() && !_tiles_visibility[i] && !_tiles_processing[i] &&
+            !_tiles_stale[i]) {
+            candidates.push_back(i);
+        }
+    }
+    for (const auto &pending : _readbacks) {
+        const auto index = _coord_tile.Find(pending.coord.x, pending.coord.y);
+        if (pending.lod == 0 && index.has_value()) {
+            std::erase(candidates, index.value());
         }
     }
+
+    // Only the least recently viewed tiles over the budget are evicted, the dirty ones stay until they are saved
+    const auto count = std::min(resident - max_resident, candidates.size());
+    std::nth_element(candidates.begin(), candidates.begin() + count, candidates.end(),
+                     [this](size_t a, size_t b) { return _tiles_viewed[a] < _tiles_viewed[b]; });
+    for (size_t i = 0; i < count; i++) {
+        EvictTile(candidates[i]);
+    }
+
+    Log::Trace(std::format(TEXT("Evicted {} tiles"), count));
 }
 
-void Canvas::CullTiles(Viewport *viewport) {
-    for (size_t i = 0; i < _tiles_aabb.size(); i++) {
-        _tiles_visibility[i] = viewport->IsVisible(_tiles_aabb[i]);
+void Canvas::EvictTile(size_t i) {
+    _layers_free.push_back(_tiles_data[i].layer);
+    _tiles_data[i].layer = no_layer;
+
+    // A decode requested before the tile was painted would restore older pixels than the file now has
+    const auto coord = _tiles_data[i].coord;
+    std::erase_if(_decodes, [coord](const PendingDecode &decode) { return decode.coord == coord; });
+}
+
+void Canvas::MarkStale(size_t i) {
+    if (!_tiles_stale[i]) {
+        _tiles_stale[i] = true;
+        _stale.push_back(_tiles_data[i].coord);
     }
 }
+
+void Canvas::BuildPyramid(Viewport *viewport, File *file, int level) {
+    const auto resolution = Preferences::Get()->_tile_resolution;
+    if (!file) {
+        return;
+    }
+
+    // The tiles of the level saved in the file are loaded as they are, a handful of them covers the whole view
+    auto &parents = _levels[level - 1];
+    const auto level_range = viewport->GetTileRange(resolution << level);
+    if (level_range.first.x > level_range.last.x || level_range.first.y > level_range.last.y) {
+        return;
+    }
+    std::vector<std::pair<int, int>> saved;
+    const auto level_count = static_cast<std::int64_t>(level_range.last.x - level_range.first.x + 1) *
+                             (level_range.last.y - level_range.first.y + 1);
+    if (level_count > static_cast<std::int64_t>(file->GetSavedTileCount(level))) {
+        for (const auto &[x, y] : file->GetSavedTileLocation(level)) {
+            if (x >= level_range.first.x && y >= level_range.first.y && x <= level_range.last.x &&
+                y <= level_range.last.y && !parents.coord_tile.Contains(x, y)) {
+                saved.push_back({x, y});
+            }
+        }
+    } else {
+        for (int y = level_range.first.y; y <= level_range.last.y; y++) {
+            for (int x = level_range.first.x; x <= level_range.last.x; x++) {
+                if (file->HasTile(x, y, level) && !parents.coord_tile.Contains(x, y)) {
+                    saved.push_back({x, y});
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<int, int>> decoded;
+    for (const auto &[x, y] : saved) {
+        if (const auto color = file->GetTileColor(x, y, level)) {
+            _tiles_pool->Fill(parents.tiles[CreateLevelTile(level, {x, y}, true)].layer, color.value());
+        } else {
+            decoded.push_back({x, y});
+        }
+    }
+    file->ReadTileTextures(
+        decoded, App::Get()->_thread_pool.get(),
+        [this, level](int x, int y, std::span<const uint32_t> pixels) {
+            auto &parents = _levels[level - 1];
+            _tiles_pool->SetPixels(parents.tiles[CreateLevelTile(level, {x, y}, true)].layer, pixels);
+        },
+        level);
+
+    // The tiles already loaded once are in the pyramid, even if they were evicted since, and the tiles under a
+    // complete tile of the level are not needed. Only complete tiles are saved
+    const auto range = viewport->GetTileRange(resolution);
+    const auto unbuilt = [this, file, level](int x, int y) {
+        if (_coord_tile.Contains(x, y)) {
+            return false;
+        }
+        const auto ancestor = Pyramid::GetAncestor({x, y}, level);
+        if (_levels[level - 1].coord_tile.Contains(ancestor.x, ancestor.y)) {
+            return !_coverage.IsComplete(level, ancestor);
+        }
+        return !file->HasTile(ancestor.x, ancestor.y, level);
+    };
+    std::vector<std::pair<int, int>> coords;
+    const auto count =
+        static_cast<std::int64_t>(range.last.x - range.first.x + 1) * (range.last.y - range.first.y + 1);
+    if (count > static_cast<std::int64_t>(file->GetSavedTileCount())) {
+        for (const auto &[x, y] : file->GetSavedTileLocation()) {
+            if (x >= range.first.x && y >= range.first.y && x <= range.last.x && y <= range.last.y && unbuilt(x, y)) {
+                coords.push_back({x, y});
+            }
+        }
+    } else {
+        for (int y = range.first.y; y <= range.last.y; y++) {
+            for (int x = range.first.x; x <= range.last.x; x++) {
+                if (file->HasTile(x, y) && unbuilt(x, y)) {
+                    coords.push_back({x, y});
+                }
+            }
+        }
+    }
+
+    // They are loaded by chunks that are downsampled and evicted right away, so the pool never holds all of them
+    constexpr size_t chunk_size = 64;
+    const auto pool = App::Get()->_thread_pool.get();
+    for (size_t start = 0; start < coords.size(); start += chunk_size) {
+        const auto chunk = std::span(coords).subspan(start, std::min(chunk_size, coords.size() - start));
+
+        decoded.clear();
+        for (const auto &[x, y] : chunk) {
+            if (file->GetTileColor(x, y)) {
+                Load({x, y}, file);
+            } else {
+                decoded.push_back({x, y});
+            }
+        }
+        file->ReadTileTextures(decoded, pool,
+                               [this](int x, int y, std::span<const uint32_t> pixels) { UploadTile({x, y}, pixels); });
+
+        UpdatePyramid(file);
+        for (const auto &[x, y] : chunk) {
+            EvictTile(_coord_tile.Find(x, y).value());
+        }
+    }
+
+    if (!saved.empty() || !coords.empty()) {
+        Log::Trace(std::format(TEXT("Loaded {} tiles of level {} and downsampled {} tiles"), saved.size(), level,
+                               coords.size()));
+    }
+}
+
+size_t Canvas::CreateLevelTile(int level, glm::ivec2 coord, bool complete) {
+    auto &parents = _levels[level - 1];
+    _coverage.AddLevelTile(level, coord, complete);
+    const auto index = parents.tiles.size();
+    parents.coord_tile.Insert(coord.x, coord.y, index);
+    parents.tiles.push_back(Tile(coord, AllocateLayer(), Preferences::Get()->_tile_resolution << level));
+    parents.stale.push_back(false);
+    parents.dirty.push_back(false);
+
+    return index;
+}
+
+void Canvas::UpdatePyramid(File *file) {
+    if (_stale.empty()) {
+        return;
+    }
+
+    const auto resolution = Preferences::Get()->_tile_resolution;
+    // local_size of downsample.comp, each dispatch writes a quarter of the parent tile
+    const auto groups = static_cast<GLuint>((resolution / 2 + 15) / 16);
+
+    std::vector<glm::ivec2> stale = std::move(_stale);
+    _stale.clear();
+    for (int level = 0; level < Pyramid::max_level && !stale.empty(); level++) {
+        auto &parents = _levels[level];
+        std::vector<glm::ivec2> next;
+        // The children of a missing parent are added to stale while it is walked
+        for (size_t i = 0; i < stale.size(); i++) {
+            const auto coord = stale[i];
+            std::uint32_t child_layer;
+            if (level == 0) {
+                const auto index = _coord_tile.Find(coord.x, coord.y);
+                if (!index.has_value() || !IsResident(index.value())) {
+                    continue;
+                }
+                _tiles_stale[index.value()] = false;
+                child_layer = _tiles_data[index.value()].layer;
+            } else {
+                auto &children = _levels[level - 1];
+                const auto index = children.coord_tile.Find(coord.x, coord.y).value();
+                children.stale[index] = false;
+                child_layer = children.tiles[index].layer;
+            }
+
+            // A parent that is not loaded yet is read from the file first, only the quadrant of coord changes, or else
+            // it is built from all its children
+            const auto parent = Pyramid::GetParent(coord);
+            auto index = parents.coord_tile.Find(parent.x, parent.y);
+            if (!index.has_value()) {
+                // Growing the pool copies it, the writes of the previous dispatches must be done
+                glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+                const bool saved = file && file->HasTile(parent.x, parent.y, level + 1);
+                index = CreateLevelTile(level + 1, parent, saved);
+                const auto layer = parents.tiles[index.value()].layer;
+                if (!saved) {
+                    _tiles_pool->Fill(layer, Preferences::Get()->_tile_default_color);
+                    LoadSiblings(level, coord, file, stale);
+                } else if (const auto color = file->GetTileColor(parent.x, parent.y, level + 1)) {
+                    _tiles_pool->Fill(layer, color.value());
+                } else {
+                    _tiles_pool->SetPixels(layer, file->ReadTileTexture(parent.x, parent.y, level + 1));
+                }
+            }
+            parents.dirty[index.value()] = true;
+            if (!parents.stale[index.value()]) {
+                parents.stale[index.value()] = true;
+                next.push_back(parent);
+            }
+
+            _downsample_program->Bind();
+            _downsample_program->SetUint("child_layer", child_layer);
+            _downsample_program->SetUint("parent_layer", parents.tiles[index.value()].layer);
+            _downsample_program->SetIVec2("quadrant", Pyramid::GetQuadrant(coord));
+            glBindImageTexture(0, _tiles_pool->ID(), 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+            glDispatchCompute(groups, groups, 1);
+            _coverage.SetDownsampled(level + 1, coord);
+        }
+
+        // The next level reads what this one wrote
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        stale = std::move(next);
+    }
+
+    // The last level has no parent to be downsampled in
+    auto &last = _levels[Pyramid::max_level - 1];
+    for (const auto coord : stale) {
+        last.stale[last.coord_tile.Find(coord.x, coord.y).value()] = false;
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+void Canvas::LoadSiblings(int level, glm::ivec2 coord, File *file, std::vector<glm::ivec2> &stale) {
+    const auto parent = Pyramid::GetParent(coord);
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            const glm::ivec2 child = parent * 2 + glm::ivec2(x, y);
+            if (child == coord) {
+                continue;
+            }
+            if (level == 0) {
+                // The tiles in the pool without a parent are all stale already, only the file is left
+                if (!_coord_tile.Contains(child.x, child.y) && file && file->HasTile(child.x, child.y)) {
+                    Load(child, file);
+                    stale.insert(stale.end(), _stale.begin(), _stale.end());
+                    _stale.clear();
+                }
+                continue;
+            }
+
+            // The tiles of the level read from the file are not downsampled when they are loaded
+            auto &children = _levels[level - 1];
+            auto index = children.coord_tile.Find(child.x, child.y);
+            if (!index.has_value()) {
+                if (!file || !file->HasTile(child.x, child.y, level)) {
+                    // The tiles under it are downsampled once they are loaded, if there are any
+                    continue;
+                }
+                index = CreateLevelTile(level, child, true);
+                const auto layer = children.tiles[index.value()].layer;
+                if (const auto color = file->GetTileColor(child.x, child.y, level)) {
+                    _tiles_pool->Fill(layer, color.value());
+                } else {
+                    _tiles_pool->SetPixels(layer, file->ReadTileTexture(child.x, child.y, level));
+                }
+            }
+            if (!children.stale[index.value()]) {
+                children.stale[index.value()] = true;
+                stale.push_back(child);
+            }
+        }
+    }
+}
+
+void Canvas::RenderTiles() {
+    const auto &tiles = _level == 0 ? _tiles_data : _levels[_level - 1].tiles;
+    const auto &visible = _level == 0 ? _tiles_visible : _levels_visible;
+    if (visible.empty()) {
+        return;
+    }
+
+    // Every visible tile is an instance of the same draw, whatever the number of tiles
+    auto instances = static_cast<Tile *>(_tile_instances->Allocate(visible.size() * sizeof(Tile)));
+    for (const auto index : visible) {
+        *instances++ = tiles[index];
+    }
+
+    _program->Bind();
+    _tiles_pool->Bind(0);
+    _mesh->RenderInstanced(GL_TRIANGLES, 6, static_cast<GLsizei>(visible.size()));
+}
+
+void Canvas::CullTiles(Viewport *viewport, int level) {
+    for (const auto index : _tiles_visible) {
+        _tiles_visibility[index] = false;
+    }
+    _tiles_visible.clear();
+    _levels_visible.clear();
+    _level = level;
+
+    // Zoomed out only the tiles of the pyramid level are drawn, none of the canvas tiles is visible then
+    const auto &coord_tile = level == 0 ? _coord_tile : _levels[level - 1].coord_tile;
+    const auto &tiles = level == 0 ? _tiles_data : _levels[level - 1].tiles;
+    auto &visible = level == 0 ? _tiles_visible : _levels_visible;
+
+    // Only the coords under the viewport are looked up, unless there are more of them than tiles when zoomed out
+    const auto size = Preferences::Get()->_tile_resolution << level;
+    const auto range = viewport->GetTileRange(size);
+    if (range.first.x > range.last.x || range.first.y > range.last.y) {
+        return;
+    }
+
+    const auto count =
+        static_cast<std::int64_t>(range.last.x - range.first.x + 1) * (range.last.y - range.first.y + 1);
+    if (count > static_cast<std::int64_t>(tiles.size())) {
+        for (size_t i = 0; i < tiles.size(); i++) {
+            const auto aabb = level == 0 ? _tiles_aabb[i]
+                                         : AABB(glm::vec2(tiles[i].coord * size),
+                                                glm::vec2((tiles[i].coord + 1) * size));
+            if (viewport->IsVisible(aabb)) {
+                visible.push_back(i);
+            }
+        }
+    } else {
+        for (int y = range.first.y; y <= range.last.y; y++) {
+            for (int x = range.first.x; x <= range.last.x; x++) {
+                if (const auto index = coord_tile.Find(x, y)) {
+                    visible.push_back(index.value());
+                }
+            }
+        }
+    }
+
+    _frame++;
+    for (const auto index : _tiles_visible) {
+        _tiles_visibility[index] = true;
+        _tiles_viewed[index] = _frame;
+    }
+}
\ No newline at end of file
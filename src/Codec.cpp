@@ -0,0 +1,219 @@
+#include "Codec.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <png.h>
+#include <zstd.h>
+
+struct Context {
+    std::span<const uint8_t> ptr;
+    size_t offset;
+};
+
+static void _png_read_from_memory(png_structp png_ptr, png_bytep data, png_size_t length) {
+    auto ctx = reinterpret_cast<Context *>(png_get_io_ptr(png_ptr));
+    if (ctx->offset + length > ctx->ptr.size()) {
+        png_error(png_ptr, "Read past the end of the tile");
+    }
+    memcpy(data, ctx->ptr.data() + ctx->offset, length);
+    ctx->offset += length;
+}
+
+static void _png_write_to_memory(png_structp png_ptr, png_bytep data, png_size_t length) {
+    auto *vec = reinterpret_cast<std::vector<uint8_t> *>(png_get_io_ptr(png_ptr));
+    vec->insert(vec->end(), data, data + length);
+}
+
+// Decode straight into pixels, which must already have the size of the tile
+static bool DecodePng(std::span<const uint8_t> data, std::span<uint32_t> pixels) {
+    const uint8_t *ptr = data.data();
+    size_t len = data.size();
+
+    Context ctx{};
+    ctx.ptr = data;
+    ctx.offset = 0;
+
+    constexpr int signature_len = 8;
+
+    if (len < signature_len) {
+        return false;
+    }
+
+    auto is_png = !png_sig_cmp(ptr, 0, signature_len);
+    if (!is_png) {
+        return false;
+    }
+
+    png_structp png_ptr{};
+    png_infop info_ptr{}, end_info{};
+
+    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!png_ptr)
+        return false;
+
+    // Allocated before setjmp, a longjmp would skip its destructor
+    std::vector<png_bytep> rows;
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        return false;
+    }
+
+    info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        return false;
+    }
+
+    end_info = png_create_info_struct(png_ptr);
+    if (!end_info) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        return false;
+    }
+
+    png_set_read_fn(png_ptr, reinterpret_cast<void *>(&ctx), _png_read_from_memory);
+    png_read_info(png_ptr, info_ptr);
+
+    size_t width = png_get_image_width(png_ptr, info_ptr);
+    size_t height = png_get_image_height(png_ptr, info_ptr);
+
+    if (width * height != pixels.size() || png_get_bit_depth(png_ptr, info_ptr) != 8 ||
+        png_get_color_type(png_ptr, info_ptr) != PNG_COLOR_TYPE_RGB_ALPHA) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        return false;
+    }
+
+    // Let libpng write the rows directly in the pixels
+    rows.resize(height);
+    uint8_t *p_ptr = reinterpret_cast<uint8_t *>(pixels.data());
+    for (size_t r = 0; r < height; r++) {
+        rows[r] = p_ptr + sizeof(uint32_t) * width * r;
+    }
+
+    png_read_image(png_ptr, rows.data());
+    png_read_end(png_ptr, end_info);
+    png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+
+    return true;
+}
+
+static std::vector<uint8_t> EncodePng(int width, int height, std::span<const uint32_t> pixels, int level) {
+    std::vector<uint8_t> data;
+
+    // libpng never writes to the rows, it just does not take them as const
+    uint8_t *ptr = reinterpret_cast<uint8_t *>(const_cast<uint32_t *>(pixels.data()));
+
+    png_structp png_ptr{};
+    png_infop info_ptr{};
+
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!png_ptr)
+        return data;
+
+    // Allocated before setjmp, a longjmp would skip its destructor
+    std::vector<uint8_t *> rows(height);
+    for (int h = 0; h < height; h++) {
+        rows[h] = ptr + sizeof(uint32_t) * width * h;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        return data;
+    }
+
+    info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        return data;
+    }
+
+    png_set_write_fn(png_ptr, reinterpret_cast<void *>(&data), _png_write_to_memory, nullptr);
+
+    png_set_compression_level(png_ptr, level);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_rows(png_ptr, info_ptr, rows.data());
+
+    png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, nullptr);
+
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    return data;
+}
+
+// The raw codecs store the RGBA8 pixels as they are in memory, the tile size comes from the file INFO
+
+// Level 0 is the fast compressor, above that it is the level of the HC compressor
+static std::vector<uint8_t> EncodeLz4(int, int, std::span<const uint32_t> pixels, int level) {
+    const auto src = reinterpret_cast<const char *>(pixels.data());
+    const int src_size = static_cast<int>(pixels.size_bytes());
+
+    std::vector<uint8_t> data(LZ4_compressBound(src_size));
+    const auto dst = reinterpret_cast<char *>(data.data());
+    const int dst_size = static_cast<int>(data.size());
+
+    const int size = level == 0 ? LZ4_compress_default(src, dst, src_size, dst_size)
+                                : LZ4_compress_HC(src, dst, src_size, dst_size, level);
+    data.resize(size);
+
+    return data;
+}
+
+static bool DecodeLz4(std::span<const uint8_t> data, std::span<uint32_t> pixels) {
+    const int size = LZ4_decompress_safe(reinterpret_cast<const char *>(data.data()),
+                                         reinterpret_cast<char *>(pixels.data()), static_cast<int>(data.size()),
+                                         static_cast<int>(pixels.size_bytes()));
+    return size == static_cast<int>(pixels.size_bytes());
+}
+
+static std::vector<uint8_t> EncodeZstd(int, int, std::span<const uint32_t> pixels, int level) {
+    std::vector<uint8_t> data(ZSTD_compressBound(pixels.size_bytes()));
+
+    const size_t size = ZSTD_compress(data.data(), data.size(), pixels.data(), pixels.size_bytes(), level);
+    data.resize(ZSTD_isError(size) ? 0 : size);
+
+    return data;
+}
+
+static bool DecodeZstd(std::span<const uint8_t> data, std::span<uint32_t> pixels) {
+    const size_t size = ZSTD_decompress(pixels.data(), pixels.size_bytes(), data.data(), data.size());
+    return !ZSTD_isError(size) && size == pixels.size_bytes();
+}
+
+static const std::array<Codec, 3> codecs = {{
+    {TileCodec::Png, "png", 4, 0, 9, EncodePng, DecodePng},
+    // Fast enough to run on every lazy save
+    {TileCodec::Lz4, "lz4", 0, 0, LZ4HC_CLEVEL_MAX, EncodeLz4, DecodeLz4},
+    // Slow to write and the smallest files, for archiving
+    {TileCodec::Zstd, "zstd", 12, 1, 22, EncodeZstd, DecodeZstd},
+}};
+
+const Codec *Codec::Get(TileCodec id) {
+    const auto codec = std::find_if(codecs.begin(), codecs.end(), [id](const Codec &c) { return c.id == id; });
+    return codec != codecs.end() ? &*codec : nullptr;
+}
+
+const Codec *Codec::Find(std::string_view name) {
+    const auto codec = std::find_if(codecs.begin(), codecs.end(), [name](const Codec &c) { return c.name == name; });
+    return codec != codecs.end() ? &*codec : nullptr;
+}
+
+std::span<const Codec> Codec::All() {
+    return codecs;
+}
+
+std::vector<uint8_t> Codec::Encode(int width, int height, std::span<const uint32_t> pixels, int level) const {
+    if (level < 0) {
+        level = default_level;
+    }
+
+    return encode(width, height, pixels, std::clamp(level, min_level, max_level));
+}
+
+bool Codec::Decode(std::span<const uint8_t> data, std::span<uint32_t> pixels) const {
+    return decode(data, pixels);
+}
\ No newline at end of file
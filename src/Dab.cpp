@@ -0,0 +1,49 @@
+#include "Dab.h"
+
+#include <cmath>
+#include <limits>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+std::vector<Dab> Dab::Interpolate(const Dab &start, const Dab &end, float step) {
+    const auto len = glm::distance(start.position, end.position);
+    const size_t step_count = std::ceil(len / step);
+
+    std::vector<Dab> dabs;
+    dabs.reserve(step_count);
+
+    float progress = 0.0f;
+    for (size_t t = 0; t < step_count; t++) {
+        if (t == 0) {
+            dabs.push_back(start);
+        } else if (t == step_count - 1) {
+            dabs.push_back(end);
+        } else {
+            Dab dab = start;
+            dab.color = glm::mix(start.color, end.color, progress);
+            dab.position = glm::mix(start.position, end.position, progress);
+            dab.pressure = std::lerp(start.pressure, end.pressure, progress);
+            dab.tilt = std::lerp(start.tilt, end.tilt, progress);
+            dab.orientation = std::lerp(start.orientation, end.orientation, progress);
+            dab.rotation = std::lerp(start.rotation, end.rotation, progress);
+            dabs.push_back(dab);
+        }
+
+        progress += 1.0f / static_cast<float>(step_count);
+    }
+
+    return dabs;
+}
+
+AABB Dab::GetBounds(std::span<const Dab> dabs) {
+    AABB bounds = {glm::vec2(std::numeric_limits<float>::max()), glm::vec2(std::numeric_limits<float>::lowest())};
+    for (const auto &dab : dabs) {
+        const float dab_radius = radius * dab.pressure;
+        if (dab_radius > 0.0f) {
+            bounds.min = glm::min(bounds.min, dab.position - dab_radius);
+            bounds.max = glm::max(bounds.max, dab.position + dab_radius);
+        }
+    }
+    return bounds;
+}
\ No newline at end of file
@@ -1,321 +1,1056 @@
 #include "File.h"
-#include "App.h"
 #include "Log.h"
-#include "Preferences.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <format>
 #include <fstream>
+#include <functional>
 #include <istream>
-#include <png.h>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
 #include <streambuf>
+#include <xxhash.h>
+
+// Version written by this build
+static constexpr std::array<uint8_t, 4> file_version = {0, 0, 8, 0};
+// First version to store its HEADER behind a FOOTER at the end of the file
+static constexpr std::array<uint8_t, 4> footer_version = {0, 0, 3, 0};
+// Size of a HEADER entry before 0.0.3.0, only coord, start and len
+static constexpr size_t legacy_header_size = 24;
+// First version that can have a PREVIEW between the HEADER and its FOOTER
+static constexpr std::array<uint8_t, 4> preview_version = {0, 0, 8, 0};
+
+static bool IsVersionAtLeast(const uint8_t version[4], const std::array<uint8_t, 4> &other) {
+    return !std::lexicographical_compare(version, version + 4, other.begin(), other.end());
+}
+
+// The codecs come from the preferences and the tools, only the ones in the registry can encode a tile
+static const Codec *GetEncoder(TileCodec codec) {
+    const auto encoder = Codec::Get(codec);
+    if (!encoder) {
+        throw std::runtime_error(
+            std::format("Tiles cannot be encoded with the codec {}", static_cast<uint32_t>(codec)));
+    }
+    return encoder;
+}
+
+// Interleave the bits of both coords so that tiles close on the canvas are close in the file
+static uint64_t MortonCode(int32_t x, int32_t y) {
+    const auto spread = [](uint32_t v) {
+        uint64_t r = v;
+        r = (r | (r << 16)) & 0x0000FFFF0000FFFFull;
+        r = (r | (r << 8)) & 0x00FF00FF00FF00FFull;
+        r = (r | (r << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        r = (r | (r << 2)) & 0x3333333333333333ull;
+        r = (r | (r << 1)) & 0x5555555555555555ull;
+        return r;
+    };
+
+    // Flip the sign bit so negative coords are ordered before positive ones
+    return spread(static_cast<uint32_t>(x) ^ 0x80000000u) | (spread(static_cast<uint32_t>(y) ^ 0x80000000u) << 1);
+}
+
+File::File() : _textures_indexes(), _hash_indexes(), _blobs(), _dirty(), _headers(), _preview() {
+    _saved = false;
+    _new = true;
+    _mapped = true;
 
-struct Context {
-    std::span<uint8_t> ptr;
-    size_t offset;
-};
+    strncpy(_info._type, "msh", sizeof(Info::_type));
+    std::copy(file_version.begin(), file_version.end(), _info._version);
+    _info._resolution = 0;
 
-static void _png_read_from_memory(png_structp png_ptr, png_bytep data, png_size_t length) {
-    auto ctx = reinterpret_cast<Context *>(png_get_io_ptr(png_ptr));
-    memcpy_s(data, length, ctx->ptr.data() + ctx->offset, length);
-    ctx->offset += length;
+    _info._footer = 0;
+    _info._header_count = 0;
+    _footer_offset = 0;
+    _filename = std::filesystem::path();
 }
 
-static void _png_write_to_memory(png_structp png_ptr, png_bytep data, png_size_t length) {
-    auto *vec = reinterpret_cast<std::vector<uint8_t> *>(png_get_io_ptr(png_ptr));
-    vec->insert(vec->end(), data, data + length);
+File::~File() {
+    // The workers still reference this file
+    for (auto &queued : _queue) {
+        if (queued.encoded.valid()) {
+            queued.encoded.wait();
+        }
+    }
+}
+
+std::unique_ptr<File> File::New(std::filesystem::path filename, int tile_resolution) {
+    auto file = std::make_unique<File>();
+
+    file->Rename(filename);
+    file->_info._resolution = tile_resolution;
+    file->_saved = true;
+    file->_new = true;
+
+    return file;
 }
 
-static std::vector<uint32_t> Read(std::span<uint8_t> data) {
-    std::vector<uint32_t> pixels;
+void File::Rename(std::filesystem::path filename) {
+    _filename = filename;
+}
 
-    uint8_t *ptr = data.data();
-    size_t len = data.size();
+std::filesystem::path File::GetFilename() const {
+    return _filename;
+}
 
-    Context ctx{};
-    ctx.ptr = data;
-    ctx.offset = 0;
+bool File::IsSaved() const {
+    return _saved;
+}
 
-    constexpr int signature_len = 8;
+bool File::IsNew() const {
+    return _new;
+}
 
-    auto is_png = !png_sig_cmp(ptr, 0, signature_len);
-    if (!is_png) {
-        return pixels;
+std::unique_ptr<File> File::Open(std::filesystem::path filename, bool mapped, size_t generation) {
+    auto file = std::make_unique<File>();
+
+    file->Rename(filename);
+    file->_saved = true;
+    file->_new = false;
+    file->_mapped = mapped;
+
+    if (mapped) {
+        // Only parse the INFO and HEADER, the tiles are read from the mapping when requested
+        file->_mapping = MappedFile::Open(filename);
+        file->ReadIndex(file->_mapping->Data(), generation);
+        return file;
+    }
+
+    // Load byte stream
+    std::filebuf fp;
+    fp.open(filename, std::ios_base::in | std::ios_base::binary);
+    if (!fp.is_open()) {
+        throw std::runtime_error("Failed to open file");
     }
 
-    png_structp png_ptr{};
-    png_infop info_ptr{}, end_info{};
+    std::vector<uint8_t> data(std::filesystem::file_size(filename));
+    fp.sgetn(reinterpret_cast<char *>(data.data()), data.size());
+    fp.close();
 
-    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    if (!png_ptr)
-        return pixels;
+    file->ReadIndex(data, generation);
+    file->LoadBlobs(data);
 
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-        return pixels;
+    return file;
+}
+
+void File::ReadIndex(std::span<const uint8_t> data, size_t generation) {
+    if (data.size() < sizeof(Info)) {
+        Log::Info("Wrong file format");
+        throw std::runtime_error("Wrong file format");
     }
+    memcpy(&_info, data.data(), sizeof(Info));
 
-    info_ptr = png_create_info_struct(png_ptr);
-    if (!info_ptr) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-        return pixels;
+    // make sure the file type is correct (_type == "msh")
+    if (strncmp(_info._type, "msh", sizeof(Info::_type)) != 0) {
+        Log::Info("Wrong file format");
+        throw std::runtime_error("Wrong file format");
     }
 
-    end_info = png_create_info_struct(png_ptr);
-    if (!end_info) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-        return pixels;
+    size_t header_start = sizeof(Info);
+    size_t header_count = _info._header_count;
+    size_t header_size = legacy_header_size;
+    uint64_t preview_end = 0;
+
+    if (IsVersionAtLeast(_info._version, footer_version)) {
+        const auto read_footer = [&](uint64_t offset) {
+            Footer footer{};
+            if (offset < sizeof(Info) || data.size() < sizeof(Footer) || offset > data.size() - sizeof(Footer)) {
+                return std::optional<Footer>();
+            }
+            memcpy(&footer, data.data() + offset, sizeof(Footer));
+            if (strncmp(footer._type, "mft", sizeof(Footer::_type)) != 0) {
+                return std::optional<Footer>();
+            }
+            return std::optional<Footer>(footer);
+        };
+
+        // The last save can be incomplete if the app closed during it, fallback on the last complete one
+        uint64_t footer_offset = data.size() >= sizeof(Footer) ? data.size() - sizeof(Footer) : 0;
+        auto footer = read_footer(footer_offset);
+        if (!footer.has_value()) {
+            Log::Info("Last save is incomplete, recovering the previous one");
+            footer_offset = _info._footer;
+            footer = read_footer(footer_offset);
+        }
+        _footer_offset = footer_offset;
+
+        for (size_t i = 0; i < generation && footer.has_value(); i++) {
+            footer_offset = footer->_previous;
+            footer = read_footer(footer_offset);
+        }
+
+        if (!footer.has_value()) {
+            Log::Info("Missing file footer");
+            throw std::runtime_error("Missing file footer");
+        }
+
+        header_start = footer->_header_start;
+        header_count = footer->_header_count;
+        header_size = footer->_header_size;
+        if (IsVersionAtLeast(_info._version, preview_version)) {
+            preview_end = footer_offset;
+        }
+    } else if (generation != 0) {
+        throw std::runtime_error("This file version only has one generation");
+    }
+
+    if (header_size == 0 || header_start > data.size() ||
+        header_count > (data.size() - header_start) / header_size) {
+        Log::Info("Truncated file header");
+        throw std::runtime_error("Truncated file header");
+    }
+
+    // Whatever is left between the HEADER and its FOOTER is the PREVIEW, it is only parsed when requested
+    const size_t header_end = header_start + header_count * header_size;
+    if (header_end < preview_end) {
+        _preview.assign(data.begin() + header_end, data.begin() + preview_end);
+    }
+
+    // Entries written by older versions are smaller, the missing fields stay at 0 (TileCodec::Png and lod 0)
+    _headers.resize(header_count);
+    _blobs.resize(header_count);
+    _dirty.resize(header_count, false);
+    for (size_t i = 0; i < header_count; i++) {
+        memcpy(&_headers[i], data.data() + header_start + i * header_size, std::min(header_size, sizeof(TileHeader)));
+    }
+
+    for (size_t i = 0; i < _headers.size(); i++) {
+        const auto &header = _headers[i];
+        if (header.start > data.size() || header.len > data.size() - header.start) {
+            Log::Info(std::format("Tile_{}_{} is out of the file bounds", header.coord[0], header.coord[1]));
+            throw std::runtime_error("Tile is out of the file bounds");
+        }
+        if (header.lod > Pyramid::max_level) {
+            Log::Info(std::format("Tile_{}_{} is in the unknown level {}", header.coord[0], header.coord[1],
+                                  header.lod));
+            throw std::runtime_error("Tile is in an unknown level of the pyramid");
+        }
+        _textures_indexes[header.lod].Insert(header.coord[0], header.coord[1], i);
+        if (header.hash != 0) {
+            _hash_indexes.emplace(header.hash, i);
+        }
+    }
+}
+
+void File::Save(std::filesystem::path filename) {
+    CommitTileTextures(true);
+
+    std::error_code ec;
+    const bool same_file = !_new && std::filesystem::equivalent(filename, _filename, ec);
+
+    // Only the tiles that changed are appended when the file already has the new layout
+    if (same_file && _footer_offset != 0) {
+        Append();
+    } else {
+        Rewrite(filename, std::nullopt, -1, true);
     }
 
-    png_set_read_fn(png_ptr, reinterpret_cast<void *>(&ctx), _png_read_from_memory);
-    png_read_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, nullptr);
+    Reload(filename);
+}
+
+void File::Repack(std::filesystem::path filename, std::optional<TileCodec> codec, int level) {
+    if (codec.has_value()) {
+        GetEncoder(codec.value());
+    }
+    CommitTileTextures(true);
 
-    size_t width = png_get_image_height(png_ptr, info_ptr);
-    size_t height = png_get_image_width(png_ptr, info_ptr);
+    // A copy written elsewhere leaves this file as it is
+    if (Rewrite(filename, codec, level, false)) {
+        Reload(filename);
+    }
+}
 
-    pixels.resize(width * height);
+void File::LoadBlobs(std::span<const uint8_t> data) {
+    std::unordered_map<uint64_t, size_t> loaded;
+    for (size_t i = 0; i < _headers.size(); i++) {
+        const auto &header = _headers[i];
+        const auto shared = loaded.find(header.start);
+        if (shared != loaded.end() && _headers[shared->second].len == header.len) {
+            _blobs[i] = _blobs[shared->second];
+            continue;
+        }
 
-    const auto rows_ptr = png_get_rows(png_ptr, info_ptr);
-    uint8_t *p_ptr = reinterpret_cast<uint8_t *>(pixels.data());
-    for (size_t r = 0; r < height; r++) {
-        memcpy_s(p_ptr + sizeof(uint32_t) * width * r, sizeof(uint32_t) * width, rows_ptr[r], sizeof(4) * width);
+        const auto body = data.subspan(header.start, header.len);
+        _blobs[i] = std::make_shared<const std::vector<uint8_t>>(body.begin(), body.end());
+        if (header.len != 0) {
+            loaded.emplace(header.start, i);
+        }
     }
+}
 
-    png_read_end(png_ptr, info_ptr);
-    png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+void File::Reload(std::filesystem::path filename) {
+    // Everything is on disk now, drop the in memory copies and read back from the mapping
+    if (_mapped) {
+        _mapping = MappedFile::Open(filename);
+        for (auto &blob : _blobs) {
+            blob.reset();
+        }
+    }
+    std::fill(_dirty.begin(), _dirty.end(), false);
 
-    return pixels;
+    _saved = true;
+    _new = false;
 }
 
-static std::vector<uint8_t> Write(int compression, int width, int height, std::vector<uint32_t> pixels) {
-    std::vector<uint8_t> data;
+void File::Append() {
+    std::filebuf file;
+    file.open(_filename, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file");
+    }
+
+    std::streampos pos = file.pubseekoff(0, std::ios::end);
+
+    // Append the changed tiles only, the others keep pointing at their previous BODY
+    std::unordered_map<uint64_t, size_t> written;
+    for (size_t index = 0; index < _blobs.size(); index++) {
+        if (!_dirty[index]) {
+            continue;
+        }
+
+        // Tiles with the same content share the first BODY written
+        const auto hash = _headers[index].hash;
+        if (const auto shared = written.find(hash); hash != 0 && shared != written.end()) {
+            CopyTileBody(index, shared->second);
+            continue;
+        }
+        written.emplace(hash, index);
 
-    uint8_t *ptr = reinterpret_cast<uint8_t *>(pixels.data());
-    size_t len = pixels.size() * sizeof(uint32_t);
+        const auto &blob = *_blobs[index];
+        _headers[index].start = pos;
+        _headers[index].len = blob.size();
+        file.sputn(reinterpret_cast<const char *>(blob.data()), blob.size());
+        pos += blob.size();
+    }
 
-    png_structp png_ptr{};
-    png_infop info_ptr{};
+    Footer footer{};
+    strncpy(footer._type, "mft", sizeof(Footer::_type));
+    footer._header_count = _headers.size();
+    footer._header_size = sizeof(TileHeader);
+    footer._header_start = pos;
+    footer._previous = _footer_offset;
+
+    file.sputn(reinterpret_cast<char *>(_headers.data()), sizeof(TileHeader) * _headers.size());
+    file.sputn(reinterpret_cast<char *>(_preview.data()), _preview.size());
+    _footer_offset = file.pubseekoff(0, std::ios::cur);
+    file.sputn(reinterpret_cast<char *>(&footer), sizeof(Footer));
+
+    // Only point INFO to the new FOOTER once it is entirely written
+    file.pubsync();
+    _info._footer = _footer_offset;
+    std::copy(file_version.begin(), file_version.end(), _info._version);
+    file.pubseekpos(0);
+    file.sputn(reinterpret_cast<char *>(&_info), sizeof(Info));
+
+    if (!file.close()) {
+        throw std::runtime_error("Failed to write file");
+    }
+}
 
-    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    if (!png_ptr)
-        return data;
+bool File::Rewrite(std::filesystem::path filename, std::optional<TileCodec> codec, int level, bool adopt) {
+    // Write next to the destination first, the mapping might still be reading from it
+    auto temp_filename = filename;
+    temp_filename += ".tmp";
 
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        png_destroy_write_struct(&png_ptr, &info_ptr);
-        return data;
+    std::filebuf file;
+    file.open(temp_filename, std::ios_base::out | std::ios_base::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file");
     }
 
-    info_ptr = png_create_info_struct(png_ptr);
-    if (!info_ptr) {
-        png_destroy_write_struct(&png_ptr, &info_ptr);
-        return data;
+    std::vector<TileHeader> tile_headers(_blobs.size());
+
+    Info info = _info;
+    std::copy(file_version.begin(), file_version.end(), info._version);
+    info._header_count = 0;
+
+    std::streampos pos = file.pubseekoff(sizeof(Info), std::ios::beg);
+
+    // Only the tiles in the index are written, level by level in Morton order so neighbours are read together
+    std::vector<size_t> order(_blobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (_headers[a].lod != _headers[b].lod) {
+            return _headers[a].lod < _headers[b].lod;
+        }
+        return MortonCode(_headers[a].coord[0], _headers[a].coord[1]) <
+               MortonCode(_headers[b].coord[0], _headers[b].coord[1]);
+    });
+
+    // write the data and saved their coords in the tile_headers, one tile at a time
+    std::vector<uint32_t> pixels(codec.has_value() ? _info._resolution * _info._resolution : 0);
+    std::unordered_map<uint64_t, size_t> written;
+    for (const auto index : order) {
+        tile_headers[index] = _headers[index];
+
+        // Tiles with the same content share the first BODY written
+        const auto hash = _headers[index].hash;
+        if (const auto shared = written.find(hash); hash != 0 && shared != written.end()) {
+            const auto &source = tile_headers[shared->second];
+            tile_headers[index].codec = source.codec;
+            tile_headers[index].color = source.color;
+            tile_headers[index].start = source.start;
+            tile_headers[index].len = source.len;
+            continue;
+        }
+        written.emplace(hash, index);
+
+        auto data = GetTileData(index);
+
+        EncodedTile recompressed{};
+        if (codec.has_value()) {
+            if (!Decode(index, pixels)) {
+                throw std::runtime_error(std::format("Failed to decode tile {},{}", _headers[index].coord[0],
+                                                     _headers[index].coord[1]));
+            }
+            recompressed = EncodeTileTexture(_headers[index].coord[0], _headers[index].coord[1], pixels, hash,
+                                             codec.value(), level);
+            data = recompressed.data;
+            tile_headers[index].codec = static_cast<uint32_t>(recompressed.codec);
+            tile_headers[index].color = recompressed.color;
+        }
+
+        tile_headers[index].start = pos;
+        tile_headers[index].len = data.size();
+        file.sputn(reinterpret_cast<const char *>(data.data()), data.size());
+        pos += data.size();
     }
 
-    png_set_write_fn(png_ptr, reinterpret_cast<void *>(&data), _png_write_to_memory, nullptr);
+    Footer footer{};
+    strncpy(footer._type, "mft", sizeof(Footer::_type));
+    footer._header_count = tile_headers.size();
+    footer._header_size = sizeof(TileHeader);
+    footer._header_start = pos;
+    footer._previous = 0;
+
+    file.sputn(reinterpret_cast<char *>(tile_headers.data()), sizeof(TileHeader) * tile_headers.size());
+    file.sputn(reinterpret_cast<char *>(_preview.data()), _preview.size());
+    const uint64_t footer_offset = file.pubseekoff(0, std::ios::cur);
+    file.sputn(reinterpret_cast<char *>(&footer), sizeof(Footer));
 
-    std::vector<uint8_t *> rows(height);
-    for (size_t h = 0; h < height; h++) {
-        rows[h] = ptr + sizeof(uint32_t) * width * h;
+    // resume infos
+    info._footer = footer_offset;
+    file.pubseekpos(0);
+    file.sputn(reinterpret_cast<char *>(&info), sizeof(Info));
+
+    if (!file.close()) {
+        throw std::runtime_error("Failed to write file");
     }
 
-    png_set_compression_level(png_ptr, compression);
-    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
-                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-    png_set_rows(png_ptr, info_ptr, rows.data());
+    // The mapping has to be released before replacing the file it maps, which then has to be adopted
+    std::error_code ec;
+    if (std::filesystem::equivalent(filename, _filename, ec)) {
+        _mapping.reset();
+        adopt = true;
+    }
+    std::filesystem::rename(temp_filename, filename);
 
-    png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, nullptr);
+    if (!adopt) {
+        return false;
+    }
 
-    png_write_end(png_ptr, info_ptr);
-    png_destroy_write_struct(&png_ptr, &info_ptr);
+    _filename = filename;
+    _info = info;
+    _footer_offset = footer_offset;
+    _headers = std::move(tile_headers);
+
+    // The in memory copies do not match the recompressed tiles anymore
+    if (codec.has_value() && !_mapped) {
+        _mapping = MappedFile::Open(filename);
+        LoadBlobs(_mapping->Data());
+        _mapping.reset();
+    }
 
-    return data;
+    return true;
 }
 
-File::File() : _textures_indexes(), _pngs() {
-    const auto tile_resolution = Preferences::Get()->_tile_resolution;
+std::vector<std::pair<int, int>> File::GetSavedTileLocation(int lod) const {
+    return GetIndex(lod).GetCoords();
+}
 
-    _saved = false;
-    _new = true;
+size_t File::GetSavedTileCount(int lod) const {
+    return GetIndex(lod).Size();
+}
 
-    strcpy_s(_info._type, "msh");
-    _info._version[0] = 0;
-    _info._version[1] = 0;
-    _info._version[2] = 2;
-    _info._version[3] = 0;
-    _info._resolution = tile_resolution;
+int File::GetTileResolution() const {
+    return _info._resolution;
+}
 
-    _info._size = 0;
-    _info._header_count = 0;
-    _filename = std::filesystem::path();
+bool File::HasTile(int x, int y, int lod) const {
+    return GetIndex(lod).Contains(x, y);
 }
 
-File::~File() {
+std::optional<uint32_t> File::GetTileColor(int x, int y, int lod) const {
+    const auto index = GetIndex(lod).Find(x, y);
+    if (!index.has_value() || static_cast<TileCodec>(_headers[index.value()].codec) != TileCodec::Uniform) {
+        return std::nullopt;
+    }
+
+    return _headers[index.value()].color;
 }
 
-std::unique_ptr<File> File::New(std::filesystem::path filename) {
-    auto file = std::make_unique<File>();
+std::optional<TileCodec> File::GetTileCodec(int x, int y, int lod) const {
+    const auto index = GetIndex(lod).Find(x, y);
+    if (!index.has_value()) {
+        return std::nullopt;
+    }
 
-    file->Rename(filename);
-    file->_saved = true;
-    file->_new = true;
+    return static_cast<TileCodec>(_headers[index.value()].codec);
+}
 
-    return file;
+std::vector<uint32_t> File::ReadTileTexture(int x, int y, int lod) const {
+    std::vector<uint32_t> texture(_info._resolution * _info._resolution);
+    ReadTileTexture(x, y, texture, lod);
+
+    return texture;
 }
 
-void File::Rename(std::filesystem::path filename) {
-    _filename = filename;
+void File::ReadTileTexture(int x, int y, std::span<uint32_t> pixels, int lod) const {
+    const auto index = GetIndex(lod).Find(x, y);
+    if (!index.has_value()) {
+        throw std::runtime_error("This file does not have this tile texture");
+    }
+
+    if (!Decode(index.value(), pixels)) {
+        Log::Info(std::format("Failed to get saved texture at coord {},{}", x, y));
+        throw std::runtime_error(std::format("Failed to get saved texture at coord {},{}", x, y));
+    }
 }
 
-std::filesystem::path File::GetFilename() const {
-    return _filename;
+std::future<std::vector<uint32_t>> File::ReadTileTextureAsync(int x, int y, ThreadPool *pool, int lod) const {
+    const auto index = GetIndex(lod).Find(x, y);
+    if (!index.has_value()) {
+        throw std::runtime_error("This file does not have this tile texture");
+    }
+
+    const size_t tile_size = _info._resolution * _info._resolution;
+    const auto &header = _headers[index.value()];
+    const auto data = GetTileData(index.value());
+
+    auto decode = [x, y, tile_size, codec = static_cast<TileCodec>(header.codec), color = header.color,
+                   body = std::vector<uint8_t>(data.begin(), data.end())]() {
+        if (codec == TileCodec::Uniform) {
+            return std::vector<uint32_t>(tile_size, color);
+        }
+
+        std::vector<uint32_t> pixels(tile_size);
+        const auto decoder = Codec::Get(codec);
+        if (!decoder || !decoder->Decode(body, pixels)) {
+            throw std::runtime_error(std::format("Failed to get saved texture at coord {},{}", x, y));
+        }
+        return pixels;
+    };
+
+    if (pool) {
+        return pool->Submit(std::move(decode));
+    }
+
+    std::packaged_task<std::vector<uint32_t>()> task(std::move(decode));
+    auto future = task.get_future();
+    task();
+    return future;
 }
 
-bool File::IsSaved() const {
-    return _saved;
+void File::ReadTileTextures(std::span<const std::pair<int, int>> coords, ThreadPool *pool,
+                            std::function<void(int x, int y, std::span<const uint32_t> pixels)> callback,
+                            int lod) const {
+    const auto &indexes = GetIndex(lod);
+    const size_t tile_size = _info._resolution * _info._resolution;
+
+    // Tile i is decoded in buffer i % buffers.size(), it is handed back once tile i - buffers.size() is consumed
+    const size_t in_flight = pool ? pool->Size() * 2 : 1;
+    std::vector<std::vector<uint32_t>> buffers(std::min(in_flight, coords.size()), std::vector<uint32_t>(tile_size));
+    std::queue<std::pair<size_t, std::future<bool>>> pending;
+    std::optional<std::pair<int, int>> failed;
+    std::exception_ptr callback_exception;
+
+    const auto consume = [&]() {
+        auto [i, future] = std::move(pending.front());
+        pending.pop();
+        if (!future.get()) {
+            failed = failed.value_or(coords[i]);
+        } else if (!failed.has_value() && !callback_exception) {
+            try {
+                callback(coords[i].first, coords[i].second, buffers[i % buffers.size()]);
+            } catch (...) {
+                callback_exception = std::current_exception();
+            }
+        }
+    };
+
+    for (size_t i = 0; i < coords.size(); i++) {
+        if (pending.size() == buffers.size()) {
+            consume();
+        }
+
+        const auto [x, y] = coords[i];
+        auto &buffer = buffers[i % buffers.size()];
+        const auto decode = [this, &indexes, x, y, &buffer]() {
+            const auto index = indexes.Find(x, y);
+            return index.has_value() && Decode(index.value(), buffer);
+        };
+
+        if (pool) {
+            pending.emplace(i, pool->Submit(decode));
+        } else {
+            std::promise<bool> result;
+            result.set_value(decode());
+            pending.emplace(i, result.get_future());
+        }
+    }
+
+    // Wait for every worker before throwing, they still write in the buffers
+    while (!pending.empty()) {
+        consume();
+    }
+
+    if (callback_exception) {
+        std::rethrow_exception(callback_exception);
+    }
+
+    if (failed.has_value()) {
+        Log::Info(std::format("Failed to get saved texture at coord {},{}", failed->first, failed->second));
+        throw std::runtime_error(
+            std::format("Failed to get saved texture at coord {},{}", failed->first, failed->second));
+    }
 }
 
-bool File::IsNew() const {
-    return _new;
+void File::WriteTileTexture(int x, int y, std::vector<uint32_t> pixels, TileCodec codec, int level) {
+    std::vector<TileTexture> tiles;
+    tiles.push_back({x, y, std::move(pixels)});
+    WriteTileTextures(std::move(tiles), nullptr, codec, level);
 }
 
-std::unique_ptr<File> File::Open(std::filesystem::path filename) {
-    auto file = std::make_unique<File>();
+void File::WriteTileTextures(std::vector<TileTexture> tiles, ThreadPool *pool, TileCodec codec, int level) {
+    QueueTileTextures(std::move(tiles), pool, codec, level);
+    CommitTileTextures(true);
+}
 
-    file->Rename(filename);
-    file->_saved = true;
-    file->_new = false;
+void File::QueueTileTextures(std::vector<TileTexture> tiles, ThreadPool *pool, TileCodec codec, int level) {
+    // Thrown here rather than on a worker, where it would only surface once the tile is committed
+    GetEncoder(codec);
+    for (auto &tile : tiles) {
+        // Only the tiles with a content that is not already in the file are encoded
+        const auto hash = Hash(tile.pixels);
+        if (GetLatestHash(tile.x, tile.y, tile.lod) == hash) {
+            continue;
+        }
 
-    // Load byte stream
-    std::filebuf fp;
-    fp.open(filename, std::ios_base::in | std::ios_base::binary);
-    if (!fp.is_open()) {
-        throw std::runtime_error("Failed to open file");
+        QueuedTile queued{tile.x, tile.y, tile.lod, hash, codec, level};
+        queued.pixels = std::make_shared<const std::vector<uint32_t>>(std::move(tile.pixels));
+
+        // Copies of a content that is in the file or being encoded share its BODY once it is committed
+        const bool duplicate =
+            FindTile(hash).has_value() || std::any_of(_queue.begin(), _queue.end(), [hash](const QueuedTile &other) {
+                return other.hash == hash && other.encoded.valid();
+            });
+        if (!duplicate) {
+            const auto encode = [this, x = tile.x, y = tile.y, lod = tile.lod, pixels = queued.pixels, hash, codec,
+                                 level]() {
+                auto encoded = EncodeTileTexture(x, y, *pixels, hash, codec, level);
+                encoded.lod = lod;
+                return encoded;
+            };
+            if (pool) {
+                queued.encoded = pool->Submit(encode);
+            } else {
+                std::promise<EncodedTile> encoded;
+                encoded.set_value(encode());
+                queued.encoded = encoded.get_future();
+            }
+        }
+
+        _queue.push_back(std::move(queued));
     }
+}
 
-    std::streampos pos{};
-    pos = fp.sgetn(reinterpret_cast<char *>(&file->_info), sizeof(Info));
+bool File::CommitTileTextures(bool wait) {
+    // Tiles are committed in the order they were queued so the last content of a tile always wins
+    while (!_queue.empty()) {
+        if (!wait && _queue.front().encoded.valid() &&
+            _queue.front().encoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
 
-    // make sure the file type is correct (_type == "msh")
-    if (strcmp(file->_info._type, "msh") != 0) {
-        Log::Info(TEXT("Wrong file format"));
-        throw std::runtime_error("Wrong file format");
+        auto queued = std::move(_queue.front());
+        _queue.pop_front();
+
+        if (queued.encoded.valid()) {
+            CommitTileTexture(queued.encoded.get());
+        } else if (const auto source = FindTile(queued.hash)) {
+            ShareTile(queued.x, queued.y, queued.lod, source.value());
+        } else {
+            // The tile it was a copy of changed in the meantime
+            auto encoded =
+                EncodeTileTexture(queued.x, queued.y, *queued.pixels, queued.hash, queued.codec, queued.level);
+            encoded.lod = queued.lod;
+            CommitTileTexture(std::move(encoded));
+        }
     }
 
-    // make sure the version is compatible
+    return true;
+}
+
+void File::RecodeTileTextures(ThreadPool *pool, TileCodec codec, int level) {
+    const auto encoder = GetEncoder(codec);
+    CommitTileTextures(true);
+
+    // Only the BODY not written yet is in memory, the uniform tiles have none. A shared one is encoded once
+    std::vector<size_t> indexes;
+    std::vector<std::pair<size_t, size_t>> shared;
+    std::unordered_map<const std::vector<uint8_t> *, size_t> blobs;
+    for (size_t i = 0; i < _blobs.size(); i++) {
+        const auto tile_codec = static_cast<TileCodec>(_headers[i].codec);
+        if (!_dirty[i] || tile_codec == codec || tile_codec == TileCodec::Uniform) {
+            continue;
+        }
+        if (const auto [first, added] = blobs.emplace(_blobs[i].get(), i); !added) {
+            shared.emplace_back(i, first->second);
+            continue;
+        }
+        indexes.push_back(i);
+    }
 
-    // uncompress the header
-    std::vector<TileHeader> _headers(file->_info._header_count);
-    file->_pngs.resize(file->_info._header_count);
+    // The workers only read the blobs, they are all replaced once every tile is encoded
+    const auto recode = [this, codec, level](size_t index) {
+        const auto &header = _headers[index];
+        std::vector<uint32_t> pixels(_info._resolution * _info._resolution);
+        if (!Decode(index, pixels)) {
+            throw std::runtime_error(std::format("Failed to decode tile {},{}", header.coord[0], header.coord[1]));
+        }
+        return EncodeTileTexture(header.coord[0], header.coord[1], pixels, header.hash, codec, level);
+    };
+
+    std::vector<std::future<EncodedTile>> encoded;
+    for (const auto index : indexes) {
+        if (pool) {
+            encoded.push_back(pool->Submit([recode, index]() { return recode(index); }));
+        } else {
+            std::promise<EncodedTile> tile;
+            tile.set_value(recode(index));
+            encoded.push_back(tile.get_future());
+        }
+    }
 
-    // for every entry in the header load the tile as compressed from the data offset and length
-    pos = fp.sgetn(reinterpret_cast<char *>(_headers.data()), sizeof(TileHeader) * _headers.size());
+    // None of the workers can still be running when a failed tile throws
+    for (auto &tile : encoded) {
+        tile.wait();
+    }
+    for (size_t i = 0; i < indexes.size(); i++) {
+        auto tile = encoded[i].get();
+        _blobs[indexes[i]] = std::make_shared<const std::vector<uint8_t>>(std::move(tile.data));
+        _headers[indexes[i]].codec = static_cast<uint32_t>(tile.codec);
+        _headers[indexes[i]].color = tile.color;
+    }
+    for (const auto &[index, source] : shared) {
+        _blobs[index] = _blobs[source];
+        CopyTileBody(index, source);
+    }
 
-    for (size_t i = 0; i < _headers.size(); i++) {
-        if ((size_t)pos != _headers[i].start) {
-            pos = fp.pubseekpos(_headers[i].start);
+    if (!indexes.empty()) {
+        Log::Info(std::format("[FILE]: Encoded {} tiles again as {}", indexes.size(), encoder->name));
+    }
+}
+
+File::EncodedTile File::EncodeTileTexture(int x, int y, std::span<const uint32_t> pixels, TileCodec codec,
+                                          int level) const {
+    return EncodeTileTexture(x, y, pixels, Hash(pixels), codec, level);
+}
+
+File::EncodedTile File::EncodeTileTexture(int x, int y, std::span<const uint32_t> pixels, uint64_t hash,
+                                          TileCodec codec, int level) const {
+    // Most tiles created around a stroke are still entirely the default color
+    if (!pixels.empty() && std::all_of(pixels.begin() + 1, pixels.end(), [&](uint32_t p) { return p == pixels[0]; })) {
+        return EncodedTile{x, y, TileCodec::Uniform, pixels[0], hash, {}};
+    }
+
+    auto data = GetEncoder(codec)->Encode(_info._resolution, _info._resolution, pixels, level);
+    if (data.empty()) {
+        throw std::runtime_error(std::format("Failed to encode tile {},{}", x, y));
+    }
+
+    return EncodedTile{x, y, codec, 0, hash, std::move(data)};
+}
+
+void File::CommitTileTexture(EncodedTile tile) {
+    const auto x = tile.x;
+    const auto y = tile.y;
+    const auto blob_index = GetOrCreateTile(x, y, tile.lod);
+
+    _blobs[blob_index] = std::make_shared<const std::vector<uint8_t>>(std::move(tile.data));
+    _headers[blob_index].codec = static_cast<uint32_t>(tile.codec);
+    _headers[blob_index].color = tile.color;
+    _headers[blob_index].hash = tile.hash;
+    _hash_indexes[tile.hash] = blob_index;
+    _dirty[blob_index] = true;
+    if (tile.codec == TileCodec::Uniform) {
+        Log::Info(std::format("[FILE]: Saved Tile_{}_{}: uniform {:#010x}", x, y, tile.color));
+    } else {
+        Log::Info(std::format("[FILE]: Saved Tile_{}_{}: {} {}/{}b", x, y, Codec::Get(tile.codec)->name,
+                              _blobs[blob_index]->size(), _info._resolution * _info._resolution * sizeof(uint32_t)));
+    }
+}
+
+File::Preview File::CreatePreview(glm::vec2 position, float zoom, float rotation, std::span<const uint32_t> pixels,
+                                  int width, int height) {
+    if (width <= 0 || height <= 0 || pixels.size() != static_cast<size_t>(width) * height) {
+        throw std::runtime_error("The view pixels are of the wrong size");
+    }
+
+    Preview preview{position, zoom, rotation, width, height, {}};
+    const int side = std::max(width, height);
+    if (side > thumbnail_size) {
+        preview.width = std::max(1, width * thumbnail_size / side);
+        preview.height = std::max(1, height * thumbnail_size / side);
+    }
+
+    // Average every pixel of the view that falls in each pixel of the thumbnail, channel by channel
+    preview.thumbnail.resize(preview.width * preview.height);
+    for (int y = 0; y < preview.height; y++) {
+        const int y0 = y * height / preview.height;
+        const int y1 = std::max(y0 + 1, (y + 1) * height / preview.height);
+        for (int x = 0; x < preview.width; x++) {
+            const int x0 = x * width / preview.width;
+            const int x1 = std::max(x0 + 1, (x + 1) * width / preview.width);
+
+            std::array<uint32_t, 4> sum{};
+            for (int sy = y0; sy < y1; sy++) {
+                for (int sx = x0; sx < x1; sx++) {
+                    const auto pixel = pixels[sy * width + sx];
+                    for (int c = 0; c < 4; c++) {
+                        sum[c] += (pixel >> (c * 8)) & 0xFF;
+                    }
+                }
+            }
+
+            const uint32_t count = (x1 - x0) * (y1 - y0);
+            uint32_t average = 0;
+            for (int c = 0; c < 4; c++) {
+                average |= ((sum[c] + count / 2) / count) << (c * 8);
+            }
+            preview.thumbnail[y * preview.width + x] = average;
         }
-        file->_pngs[i].resize(_headers[i].len, 0);
-        pos = fp.sgetn(reinterpret_cast<char *>(file->_pngs[i].data()), file->_pngs[i].size());
-        file->_textures_indexes.emplace(std::pair<int, int>{_headers[i].coord[0], _headers[i].coord[1]}, i);
     }
 
-    fp.close();
+    return preview;
+}
 
-    return file;
+void File::SetPreview(const Preview &preview) {
+    if (preview.width <= 0 || preview.height <= 0 ||
+        preview.thumbnail.size() != static_cast<size_t>(preview.width) * preview.height) {
+        throw std::runtime_error("The thumbnail pixels are of the wrong size");
+    }
+
+    const auto thumbnail = Codec::Get(TileCodec::Png)->Encode(preview.width, preview.height, preview.thumbnail);
+    if (thumbnail.empty()) {
+        throw std::runtime_error("Failed to encode the thumbnail");
+    }
+
+    PreviewHeader header{};
+    strncpy(header._type, "mpv", sizeof(PreviewHeader::_type));
+    header._position[0] = preview.position.x;
+    header._position[1] = preview.position.y;
+    header._zoom = preview.zoom;
+    header._rotation = preview.rotation;
+    header._width = preview.width;
+    header._height = preview.height;
+    header._len = thumbnail.size();
+
+    _preview.resize(sizeof(PreviewHeader) + thumbnail.size());
+    memcpy(_preview.data(), &header, sizeof(PreviewHeader));
+    memcpy(_preview.data() + sizeof(PreviewHeader), thumbnail.data(), thumbnail.size());
 }
 
-void File::Save(std::filesystem::path filename) {
-    std::filebuf file;
-    file.open(filename, std::ios_base::out | std::ios_base::binary | std::ios::trunc);
-    if (!file.is_open()) {
+std::optional<File::Preview> File::GetPreview() const {
+    return ParsePreview(_preview);
+}
+
+std::optional<File::Preview> File::ReadPreview(std::filesystem::path filename) {
+    std::filebuf fp;
+    fp.open(filename, std::ios_base::in | std::ios_base::binary);
+    if (!fp.is_open()) {
         throw std::runtime_error("Failed to open file");
     }
 
-    std::streampos pos{};
+    const uint64_t size = fp.pubseekoff(0, std::ios::end);
+    const auto read = [&](uint64_t offset, void *data, size_t len) {
+        return offset <= size && len <= size - offset && fp.pubseekpos(offset) == std::streampos(offset) &&
+               fp.sgetn(reinterpret_cast<char *>(data), len) == static_cast<std::streamsize>(len);
+    };
 
-    std::vector<TileHeader> tile_headers(_pngs.size());
-    _info._header_count = _pngs.size();
+    Info info{};
+    if (!read(0, &info, sizeof(Info)) || strncmp(info._type, "msh", sizeof(Info::_type)) != 0) {
+        throw std::runtime_error("Wrong file format");
+    }
+    if (!IsVersionAtLeast(info._version, preview_version)) {
+        return std::nullopt;
+    }
 
-    std::streampos header_pos = pos;
-    // reserve sizeof(TileHeader) * _info._header_count to save the header later on
-    pos = file.pubseekoff(sizeof(Info) + (sizeof(TileHeader) * _info._header_count), std::ios::beg);
+    // Same recovery as ReadIndex when the last save is incomplete
+    const auto read_footer = [&](uint64_t offset) {
+        Footer footer{};
+        if (offset < sizeof(Info) || !read(offset, &footer, sizeof(Footer)) ||
+            strncmp(footer._type, "mft", sizeof(Footer::_type)) != 0) {
+            return std::optional<Footer>();
+        }
+        return std::optional<Footer>(footer);
+    };
+    uint64_t footer_offset = size >= sizeof(Footer) ? size - sizeof(Footer) : 0;
+    auto footer = read_footer(footer_offset);
+    if (!footer.has_value()) {
+        footer_offset = info._footer;
+        footer = read_footer(footer_offset);
+    }
+    if (!footer.has_value()) {
+        throw std::runtime_error("Missing file footer");
+    }
 
-    // write the data and saved their coords in the tile_headers
-    for (const auto &[coord, index] : _textures_indexes) {
-        tile_headers[index].coord[0] = coord.first;
-        tile_headers[index].coord[1] = coord.second;
-        tile_headers[index].start = file.pubseekoff(0, std::ios::cur);
-        tile_headers[index].len = _pngs[index].size();
-        pos = file.sputn(reinterpret_cast<char *>(_pngs[index].data()), _pngs[index].size());
-        file.pubsync();
+    const uint64_t header_size = static_cast<uint64_t>(footer->_header_count) * footer->_header_size;
+    if (footer->_header_start > footer_offset || header_size > footer_offset - footer->_header_start) {
+        throw std::runtime_error("Truncated file header");
     }
+    const uint64_t preview_start = footer->_header_start + header_size;
 
-    _info._size = 0;
+    std::vector<uint8_t> preview(footer_offset - preview_start);
+    if (!read(preview_start, preview.data(), preview.size())) {
+        throw std::runtime_error("Failed to read the preview");
+    }
 
-    // resume infos
-    pos = file.pubseekpos(0);
-    pos = file.sputn(reinterpret_cast<char *>(&_info), sizeof(_info));
-    pos = file.sputn(reinterpret_cast<char *>(tile_headers.data()), sizeof(TileHeader) * tile_headers.size());
+    return ParsePreview(preview);
+}
 
-    file.close();
+std::optional<File::Preview> File::ParsePreview(std::span<const uint8_t> data) {
+    if (data.empty()) {
+        return std::nullopt;
+    }
 
-    _saved = true;
-    _new = false;
+    PreviewHeader header{};
+    if (data.size() < sizeof(PreviewHeader)) {
+        Log::Info("Truncated file preview");
+        return std::nullopt;
+    }
+    memcpy(&header, data.data(), sizeof(PreviewHeader));
+    if (strncmp(header._type, "mpv", sizeof(PreviewHeader::_type)) != 0 ||
+        header._len > data.size() - sizeof(PreviewHeader) || header._width > thumbnail_size ||
+        header._height > thumbnail_size) {
+        Log::Info("Corrupted file preview");
+        return std::nullopt;
+    }
+
+    Preview preview{{header._position[0], header._position[1]},
+                    header._zoom,
+                    header._rotation,
+                    static_cast<int>(header._width),
+                    static_cast<int>(header._height),
+                    {}};
+    preview.thumbnail.resize(header._width * header._height);
+    if (!Codec::Get(TileCodec::Png)->Decode(data.subspan(sizeof(PreviewHeader), header._len), preview.thumbnail)) {
+        Log::Info("Corrupted file preview thumbnail");
+        return std::nullopt;
+    }
+
+    return preview;
 }
 
-tstring File::GetDisplayName() {
-    if (!_saved || !App::Get()->_canvas->IsSaved()) {
-        return std::format(TEXT("*{}"), _filename.filename().wstring());
+std::span<const uint8_t> File::GetTileData(size_t index) const {
+    if (_blobs[index]) {
+        return *_blobs[index];
     }
-    // FIXME: This and all the other call using .wstring() will break ansi compatibility
-    return _filename.filename().wstring();
+    if (!_mapping) {
+        return {};
+    }
+
+    const auto &header = _headers[index];
+    return _mapping->Data().subspan(header.start, header.len);
 }
 
-std::vector<std::pair<int, int>> File::GetSavedTileLocation() const {
-    std::vector<std::pair<int, int>> tiles_saved;
-    tiles_saved.reserve(_textures_indexes.size());
+bool File::Decode(size_t index, std::span<uint32_t> pixels) const {
+    if (static_cast<TileCodec>(_headers[index].codec) == TileCodec::Uniform) {
+        std::fill(pixels.begin(), pixels.end(), _headers[index].color);
+        return true;
+    }
 
-    for (const auto &[key, val] : _textures_indexes) {
-        tiles_saved.push_back(key);
+    const auto codec = Codec::Get(static_cast<TileCodec>(_headers[index].codec));
+    if (!codec) {
+        Log::Info(std::format("Tile_{}_{} uses the unknown codec {}", _headers[index].coord[0],
+                              _headers[index].coord[1], _headers[index].codec));
+        return false;
     }
 
-    return tiles_saved;
+    return codec->Decode(GetTileData(index), pixels);
 }
 
-int File::GetTileResolution() const {
-    return _info._resolution;
+uint64_t File::Hash(std::span<const uint32_t> pixels) {
+    return XXH3_64bits(pixels.data(), pixels.size_bytes());
 }
 
-bool File::HasTile(int x, int y) const {
-    return _textures_indexes.contains({x, y});
-}
+std::optional<uint64_t> File::GetLatestHash(int x, int y, int lod) const {
+    const auto queued = std::find_if(_queue.rbegin(), _queue.rend(), [x, y, lod](const QueuedTile &tile) {
+        return tile.x == x && tile.y == y && tile.lod == lod;
+    });
+    if (queued != _queue.rend()) {
+        return queued->hash;
+    }
 
-std::vector<uint32_t> File::ReadTileTexture(int x, int y) {
-    if (!_textures_indexes.contains({x, y})) {
-        throw std::runtime_error("This file does not have this tile texture");
+    const auto index = GetIndex(lod).Find(x, y);
+    if (!index.has_value()) {
+        return std::nullopt;
     }
 
-    size_t png_index = _textures_indexes[{x, y}];
-    std::vector<uint32_t> texture = Read(_pngs[png_index]);
+    return _headers[index.value()].hash;
+}
 
-    if (texture.size() <= 0) {
-        Log::Info(std::format(TEXT("Failed to get saved texture at coord {},{}"), x, y));
-        throw std::runtime_error(std::format("Failed to get saved texture at coord {},{}", x, y));
+std::optional<size_t> File::FindTile(uint64_t hash) const {
+    // The entry is stale when its tile was overwritten since
+    const auto index = _hash_indexes.find(hash);
+    if (hash == 0 || index == _hash_indexes.end() || _headers[index->second].hash != hash) {
+        return std::nullopt;
     }
 
-    return texture;
+    return index->second;
 }
 
-void File::WriteTileTexture(int x, int y, std::vector<uint32_t> pixels, int compression) {
-    size_t png_index;
-    if (!_textures_indexes.contains({x, y})) {
-        png_index = _pngs.size();
-        _pngs.push_back({});
-        _textures_indexes.emplace(std::pair<int, int>(x, y), png_index);
-        Log::Info(std::format(TEXT("[FILE]: Added new Tile_{}_{}"), x, y));
-    } else {
-        png_index = _textures_indexes[{x, y}];
+size_t File::GetOrCreateTile(int x, int y, int lod) {
+    if (const auto index = GetIndex(lod).Find(x, y)) {
+        return index.value();
     }
 
-    _pngs[png_index] = Write(compression, _info._resolution, _info._resolution, pixels);
-    Log::Info(std::format(TEXT("[FILE]: Saved Tile_{}_{}: {}/{}b"), x, y, _pngs[png_index].size(),
-                          pixels.size() * sizeof(uint32_t)));
+    const auto index = _blobs.size();
+    _blobs.push_back(nullptr);
+    _dirty.push_back(false);
+    _headers.push_back({{x, y}, 0, 0, 0, 0, 0, static_cast<uint32_t>(lod), 0});
+    _textures_indexes[lod].Insert(x, y, index);
+    Log::Info(std::format("[FILE]: Added new Tile_{}_{}", x, y));
+
+    return index;
+}
+
+void File::ShareTile(int x, int y, int lod, size_t source) {
+    const auto index = GetOrCreateTile(x, y, lod);
+    _headers[index].hash = _headers[source].hash;
+    CopyTileBody(index, source);
+
+    // A BODY that is not written yet is only kept once, and written once by Append
+    _blobs[index] = _blobs[source];
+    _dirty[index] = _dirty[source];
+    Log::Info(std::format("[FILE]: Shared Tile_{}_{} with Tile_{}_{}", x, y, _headers[source].coord[0],
+                          _headers[source].coord[1]));
+}
+
+void File::CopyTileBody(size_t index, size_t source) {
+    _headers[index].codec = _headers[source].codec;
+    _headers[index].color = _headers[source].color;
+    _headers[index].start = _headers[source].start;
+    _headers[index].len = _headers[source].len;
+}
+
+const TileIndex &File::GetIndex(int lod) const {
+    if (lod < 0 || lod > Pyramid::max_level) {
+        throw std::runtime_error(std::format("Level {} is not in the pyramid", lod));
+    }
+    return _textures_indexes[lod];
 }
\ No newline at end of file
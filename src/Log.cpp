@@ -1,12 +1,49 @@
 #include "Log.h"
 
-void Log::Info(const tstring& msg) noexcept
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <cstdio>
+#endif
+
+// Only the Win32 app has a debugger output, headless tools print to stderr
+#ifdef _WIN32
+static void Output(const std::string& log) {
+	OutputDebugStringA(log.c_str());
+}
+
+static void Output(const std::wstring& log) {
+	OutputDebugStringW(log.c_str());
+}
+#else
+static void Output(const std::string& log) {
+	std::fputs(log.c_str(), stderr);
+}
+
+static void Output(const std::wstring& log) {
+	std::fputws(log.c_str(), stderr);
+}
+#endif
+
+void Log::Info(const std::string& msg) noexcept
 {
-	tstring log = TEXT("[MASHIRO] [INFO]: ") + msg + TEXT("\n");
-	OutputDebugString(log.c_str());
+	std::string log = "[MASHIRO] [INFO]: " + msg + "\n";
+	Output(log);
+}
+
+void Log::Trace(const std::string& msg) noexcept {
+	std::string log = "[MASHIRO] [TRACE]: " + msg + "\n";
+	Output(log);
 }
 
-void Log::Trace(const tstring& msg) noexcept {
-	tstring log = TEXT("[MASHIRO] [TRACE]: ") + msg + TEXT("\n");
-	OutputDebugString(log.c_str());
+void Log::Info(const std::wstring& msg) noexcept
+{
+	std::wstring log = L"[MASHIRO] [INFO]: " + msg + L"\n";
+	Output(log);
 }
+
+void Log::Trace(const std::wstring& msg) noexcept {
+	std::wstring log = L"[MASHIRO] [TRACE]: " + msg + L"\n";
+	Output(log);
+}
\ No newline at end of file
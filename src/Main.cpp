@@ -12,9 +12,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
         if (lpCmdLine && *lpCmdLine) {
             if (std::filesystem::exists(lpCmdLine)) {
-                app._file = File::Open(lpCmdLine);
-                app._canvas = Canvas::Open(app._file.get());
-                SetWindowText(app._window->Hwnd(), app._file->GetDisplayName().c_str());
+                app.OpenFile(lpCmdLine);
             }
         } else {
             app.New();
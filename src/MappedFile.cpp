@@ -0,0 +1,128 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+MappedFile::MappedFile() : _file(INVALID_HANDLE_VALUE), _mapping(nullptr), _data(nullptr), _size(0) {
+}
+
+std::unique_ptr<MappedFile> MappedFile::Open(std::filesystem::path filename) {
+    auto mapped = std::make_unique<MappedFile>();
+
+    // Share write so the file can still be appended to while it is mapped
+    mapped->_file = CreateFileW(filename.wstring().c_str(), GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (mapped->_file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open file");
+    }
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(mapped->_file, &size)) {
+        throw std::runtime_error("Failed to get file size");
+    }
+    mapped->_size = static_cast<std::size_t>(size.QuadPart);
+
+    // An empty file cannot be mapped, keep an empty view instead
+    if (mapped->_size == 0) {
+        return mapped;
+    }
+
+    mapped->_mapping = CreateFileMappingW(mapped->_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapped->_mapping) {
+        throw std::runtime_error("Failed to create file mapping");
+    }
+
+    mapped->_data = reinterpret_cast<const std::uint8_t *>(MapViewOfFile(mapped->_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped->_data) {
+        throw std::runtime_error("Failed to map view of file");
+    }
+
+    return mapped;
+}
+
+void MappedFile::Release() {
+    if (_data) {
+        UnmapViewOfFile(_data);
+        _data = nullptr;
+    }
+
+    if (_mapping) {
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+    }
+
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+        _file = INVALID_HANDLE_VALUE;
+    }
+
+    _size = 0;
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The mapping outlives its descriptor on POSIX, _file and _mapping stay unused
+MappedFile::MappedFile() : _file(nullptr), _mapping(nullptr), _data(nullptr), _size(0) {
+}
+
+std::unique_ptr<MappedFile> MappedFile::Open(std::filesystem::path filename) {
+    auto mapped = std::make_unique<MappedFile>();
+
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file");
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to get file size");
+    }
+    mapped->_size = static_cast<std::size_t>(info.st_size);
+
+    // An empty file cannot be mapped, keep an empty view instead
+    if (mapped->_size == 0) {
+        close(fd);
+        return mapped;
+    }
+
+    void *data = mmap(nullptr, mapped->_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        mapped->_size = 0;
+        throw std::runtime_error("Failed to map view of file");
+    }
+    madvise(data, mapped->_size, MADV_RANDOM);
+    mapped->_data = reinterpret_cast<const std::uint8_t *>(data);
+
+    return mapped;
+}
+
+void MappedFile::Release() {
+    if (_data) {
+        munmap(const_cast<std::uint8_t *>(_data), _size);
+        _data = nullptr;
+    }
+
+    _size = 0;
+}
+#endif
+
+MappedFile::~MappedFile() {
+    Release();
+}
+
+std::span<const std::uint8_t> MappedFile::Data() const noexcept {
+    return {_data, _size};
+}
+
+std::size_t MappedFile::Size() const noexcept {
+    return _size;
+}
@@ -12,12 +12,24 @@ Preferences* Preferences::Get() {
 Preferences::Preferences() {
 	_tile_resolution = 256;
 	_lazy_save_count = 4;
+	_tile_memory_budget = 512;
+	_tile_stream_margin = 1;
+	_tile_stream_count = 8;
+	_tile_prefetch_time = 0.3f;
+	_tile_prefetch_count = 16;
 	_tile_default_color = 0x00FFFFFF;
 
 	_file_recents_max;
 	_file_recents;
 	_file_last_openned;
 	_brush_step = 0.5f;
+	_brush_cpu = false;
+	_thread_pool_size = 0;
+
+	_save_codec = TileCodec::Png;
+	_save_codec_level = -1;
+	_lazy_save_codec = TileCodec::Lz4;
+	_lazy_save_codec_level = -1;
 
 	g_preferences = this;
 }
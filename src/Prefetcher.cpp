@@ -0,0 +1,45 @@
+#include "Prefetcher.h"
+
+#include <cmath>
+
+Prefetcher::Prefetcher()
+    : _started(false), _time(0.0), _position(0.0f), _zoom(1.0f), _velocity(0.0f), _zoom_rate(0.0f) {
+}
+
+void Prefetcher::Update(const Viewport &viewport, double time) {
+    const auto position = viewport.GetPosition();
+    const auto zoom = viewport.GetZoom();
+    const auto interval = time - _time;
+
+    if (!_started || interval > max_interval) {
+        _velocity = glm::vec2(0.0f);
+        _zoom_rate = 0.0f;
+    } else if (interval > 0.0) {
+        // Half of each new rate is kept so a single irregular frame does not throw the prediction off
+        const auto seconds = static_cast<float>(interval);
+        _velocity = (_velocity + (position - _position) / seconds) * 0.5f;
+        _zoom_rate = (_zoom_rate + std::log(zoom / _zoom) / seconds) * 0.5f;
+    } else {
+        return;
+    }
+
+    _started = true;
+    _time = time;
+    _position = position;
+    _zoom = zoom;
+}
+
+Viewport Prefetcher::Predict(const Viewport &viewport, float ahead) const {
+    Viewport predicted = viewport;
+    predicted.SetZoom(viewport.GetZoom() * std::exp(_zoom_rate * ahead), false);
+    predicted.SetPosition(viewport.GetPosition() + _velocity * ahead);
+    return predicted;
+}
+
+glm::vec2 Prefetcher::GetVelocity() const noexcept {
+    return _velocity;
+}
+
+float Prefetcher::GetZoomRate() const noexcept {
+    return _zoom_rate;
+}
\ No newline at end of file
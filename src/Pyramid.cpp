@@ -0,0 +1,86 @@
+#include "Pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+glm::ivec2 Pyramid::GetParent(glm::ivec2 coord) noexcept {
+    // Arithmetic shift floors the negative coords too
+    return {coord.x >> 1, coord.y >> 1};
+}
+
+glm::ivec2 Pyramid::GetQuadrant(glm::ivec2 coord) noexcept {
+    return {coord.x & 1, coord.y & 1};
+}
+
+glm::ivec2 Pyramid::GetAncestor(glm::ivec2 coord, int levels) noexcept {
+    return {coord.x >> levels, coord.y >> levels};
+}
+
+int Pyramid::GetLevel(float zoom) noexcept {
+    if (!(zoom > 0.0f)) {
+        return 0;
+    }
+    return std::clamp(static_cast<int>(std::floor(-std::log2(zoom))), 0, max_level);
+}
+
+static std::uint8_t GetQuadrantBit(glm::ivec2 coord) noexcept {
+    const auto quadrant = Pyramid::GetQuadrant(coord);
+    return static_cast<std::uint8_t>(1 << (quadrant.y * 2 + quadrant.x));
+}
+
+void PyramidCoverage::AddTile(glm::ivec2 coord) {
+    // The levels over a tile that is already known already have content
+    for (int level = 0; level <= Pyramid::max_level; level++) {
+        if (!_content[level].Insert(coord.x, coord.y, 0)) {
+            return;
+        }
+        coord = Pyramid::GetParent(coord);
+    }
+}
+
+bool PyramidCoverage::HasContent(int level, glm::ivec2 coord) const {
+    return _content[level].Contains(coord.x, coord.y);
+}
+
+void PyramidCoverage::AddLevelTile(int level, glm::ivec2 coord, bool complete) {
+    std::uint8_t quadrants = 0x0F;
+    if (!complete) {
+        quadrants = 0;
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 2; x++) {
+                const glm::ivec2 child = coord * 2 + glm::ivec2(x, y);
+                if (!HasContent(level - 1, child)) {
+                    quadrants |= GetQuadrantBit(child);
+                }
+            }
+        }
+    }
+
+    if (const auto index = _tiles[level].Find(coord.x, coord.y)) {
+        _quadrants[level][index.value()] = quadrants;
+        return;
+    }
+    _tiles[level].Insert(coord.x, coord.y, _quadrants[level].size());
+    _quadrants[level].push_back(quadrants);
+}
+
+void PyramidCoverage::SetDownsampled(int level, glm::ivec2 child) {
+    const auto parent = Pyramid::GetParent(child);
+    auto &quadrants = _quadrants[level][_tiles[level].Find(parent.x, parent.y).value()];
+
+    // A partial child leaves its quadrant partial, even if it was complete before
+    if (IsComplete(level - 1, child)) {
+        quadrants |= GetQuadrantBit(child);
+    } else {
+        quadrants &= ~GetQuadrantBit(child);
+    }
+}
+
+bool PyramidCoverage::IsComplete(int level, glm::ivec2 coord) const {
+    if (level == 0) {
+        return true;
+    }
+
+    const auto index = _tiles[level].Find(coord.x, coord.y);
+    return index.has_value() && _quadrants[level][index.value()] == 0x0F;
+}
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glm/common.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MASHIRO_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MASHIRO_NEON
+#include <arm_neon.h>
+#endif
+
+// MSVC accepts the AVX2 intrinsics anywhere, GCC and Clang only in functions built for AVX2
+#if defined(MASHIRO_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MASHIRO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MASHIRO_TARGET_AVX2
+#endif
+
+// What every pixel of a dab needs, computed once per dab
+struct DabParams {
+    glm::vec2 position;
+    float radius;
+    // 1 - alpha and color * alpha of the mix
+    float keep;
+    float color[4];
+};
+
+// x is the canvas position of the first pixel, dy2 the squared distance of the row to the dab
+static void PaintRowScalar(std::uint32_t *pixels, int count, float x, float dy2, const DabParams &dab) {
+    for (int i = 0; i < count; i++) {
+        const float dx = (x + static_cast<float>(i)) - dab.position.x;
+        if (!(std::sqrt(dx * dx + dy2) < dab.radius)) {
+            continue;
+        }
+
+        std::uint32_t pixel = 0;
+        for (int c = 0; c < 4; c++) {
+            float value = static_cast<float>((pixels[i] >> (8 * c)) & 0xFF) / 255.0f;
+            value = std::clamp(value * dab.keep + dab.color[c], 0.0f, 1.0f);
+            pixel |= static_cast<std::uint32_t>(value * 255.0f + 0.5f) << (8 * c);
+        }
+        pixels[i] = pixel;
+    }
+}
+
+#ifdef MASHIRO_X86
+static void PaintRowSse2(std::uint32_t *pixels, int count, float x, float dy2, const DabParams &dab) {
+    const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 position = _mm_set1_ps(dab.position.x);
+    const __m128 radius = _mm_set1_ps(dab.radius);
+    const __m128 keep = _mm_set1_ps(dab.keep);
+    const __m128 row = _mm_set1_ps(dy2);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 max = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i byte = _mm_set1_epi32(0xFF);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(x + static_cast<float>(i)), offsets), position);
+        const __m128 inside = _mm_cmplt_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), row)), radius);
+        if (_mm_movemask_ps(inside) == 0) {
+            continue;
+        }
+
+        const __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+        __m128i result = _mm_setzero_si128();
+        for (int c = 0; c < 4; c++) {
+            const __m128i shift = _mm_cvtsi32_si128(8 * c);
+            __m128 value = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(source, shift), byte)), max);
+            value = _mm_add_ps(_mm_mul_ps(value, keep), _mm_set1_ps(dab.color[c]));
+            value = _mm_max_ps(_mm_min_ps(value, one), zero);
+            const __m128i channel = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, max), half));
+            result = _mm_or_si128(result, _mm_sll_epi32(channel, shift));
+        }
+
+        const __m128i mask = _mm_castps_si128(inside);
+        result = _mm_or_si128(_mm_and_si128(mask, result), _mm_andnot_si128(mask, source));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), result);
+    }
+
+    PaintRowScalar(pixels + i, count - i, x + static_cast<float>(i), dy2, dab);
+}
+
+MASHIRO_TARGET_AVX2 static void PaintRowAvx2(std::uint32_t *pixels, int count, float x, float dy2,
+                                             const DabParams &dab) {
+    const __m256 offsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 position = _mm256_set1_ps(dab.position.x);
+    const __m256 radius = _mm256_set1_ps(dab.radius);
+    const __m256 keep = _mm256_set1_ps(dab.keep);
+    const __m256 row = _mm256_set1_ps(dy2);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 max = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i byte = _mm256_set1_epi32(0xFF);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 dx = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(x + static_cast<float>(i)), offsets), position);
+        const __m256 inside =
+            _mm256_cmp_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), row)), radius, _CMP_LT_OQ);
+        if (_mm256_movemask_ps(inside) == 0) {
+            continue;
+        }
+
+        const __m256i source = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i));
+        __m256i result = _mm256_setzero_si256();
+        for (int c = 0; c < 4; c++) {
+            const __m128i shift = _mm_cvtsi32_si128(8 * c);
+            __m256 value =
+                _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(source, shift), byte)), max);
+            value = _mm256_add_ps(_mm256_mul_ps(value, keep), _mm256_set1_ps(dab.color[c]));
+            value = _mm256_max_ps(_mm256_min_ps(value, one), zero);
+            const __m256i channel = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, max), half));
+            result = _mm256_or_si256(result, _mm256_sll_epi32(channel, shift));
+        }
+
+        result = _mm256_blendv_epi8(source, result, _mm256_castps_si256(inside));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i), result);
+    }
+
+    PaintRowScalar(pixels + i, count - i, x + static_cast<float>(i), dy2, dab);
+}
+
+static bool HasAvx2() {
+#ifdef _MSC_VER
+    int info[4]{};
+    __cpuid(info, 1);
+    const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+    if (!avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef MASHIRO_NEON
+static void PaintRowNeon(std::uint32_t *pixels, int count, float x, float dy2, const DabParams &dab) {
+    const float offsets_data[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    const float32x4_t offsets = vld1q_f32(offsets_data);
+    const float32x4_t position = vdupq_n_f32(dab.position.x);
+    const float32x4_t radius = vdupq_n_f32(dab.radius);
+    const float32x4_t keep = vdupq_n_f32(dab.keep);
+    const float32x4_t row = vdupq_n_f32(dy2);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t max = vdupq_n_f32(255.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const uint32x4_t byte = vdupq_n_u32(0xFF);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t dx = vsubq_f32(vaddq_f32(vdupq_n_f32(x + static_cast<float>(i)), offsets), position);
+        const uint32x4_t inside = vcltq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(dx, dx), row)), radius);
+        if (vmaxvq_u32(inside) == 0) {
+            continue;
+        }
+
+        const uint32x4_t source = vld1q_u32(pixels + i);
+        uint32x4_t result = vdupq_n_u32(0);
+        for (int c = 0; c < 4; c++) {
+            float32x4_t value =
+                vdivq_f32(vcvtq_f32_u32(vandq_u32(vshlq_u32(source, vdupq_n_s32(-8 * c)), byte)), max);
+            value = vaddq_f32(vmulq_f32(value, keep), vdupq_n_f32(dab.color[c]));
+            value = vmaxq_f32(vminq_f32(value, one), zero);
+            const uint32x4_t channel = vcvtq_u32_f32(vaddq_f32(vmulq_f32(value, max), half));
+            result = vorrq_u32(result, vshlq_u32(channel, vdupq_n_s32(8 * c)));
+        }
+
+        vst1q_u32(pixels + i, vbslq_u32(inside, result, source));
+    }
+
+    PaintRowScalar(pixels + i, count - i, x + static_cast<float>(i), dy2, dab);
+}
+#endif
+
+using PaintRow = void (*)(std::uint32_t *pixels, int count, float x, float dy2, const DabParams &dab);
+
+static PaintRow GetPaintRow(Rasterizer::Backend backend) {
+    switch (backend) {
+    case Rasterizer::Backend::Scalar:
+        return PaintRowScalar;
+#ifdef MASHIRO_X86
+    case Rasterizer::Backend::Sse2:
+        return PaintRowSse2;
+    case Rasterizer::Backend::Avx2:
+        return HasAvx2() ? PaintRowAvx2 : nullptr;
+#endif
+#ifdef MASHIRO_NEON
+    case Rasterizer::Backend::Neon:
+        return PaintRowNeon;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+void Rasterizer::Paint(std::span<const Dab> dabs, glm::ivec2 coord, int resolution, std::span<std::uint32_t> pixels) {
+    Paint(GetBackend(), dabs, coord, resolution, pixels);
+}
+
+void Rasterizer::Paint(Backend backend, std::span<const Dab> dabs, glm::ivec2 coord, int resolution,
+                       std::span<std::uint32_t> pixels) {
+    if (pixels.size() != static_cast<size_t>(resolution) * resolution) {
+        throw std::runtime_error("The pixels do not match the tile resolution");
+    }
+
+    const auto paint_row = GetPaintRow(backend);
+    if (!paint_row) {
+        throw std::runtime_error("This rasterizer backend is not supported");
+    }
+
+    const glm::ivec2 origin = coord * resolution;
+    for (const auto &dab : dabs) {
+        // Same as 1.0 - step(radius, distance) in brush.comp, nothing is inside a dab without pressure
+        const float radius = Dab::radius * dab.pressure;
+        if (!(radius > 0.0f)) {
+            continue;
+        }
+
+        // Only the pixels around the dab can be inside it, the others are left as they are like the shader does
+        const glm::ivec2 min = glm::clamp(glm::ivec2(glm::floor(dab.position - radius)) - origin, 0, resolution);
+        const glm::ivec2 max = glm::clamp(glm::ivec2(glm::ceil(dab.position + radius)) + 1 - origin, 0, resolution);
+        if (min.x >= max.x || min.y >= max.y) {
+            continue;
+        }
+
+        const float alpha = dab.color.a;
+        DabParams params = {dab.position, radius, 1.0f - alpha};
+        params.color[0] = dab.color.r * alpha;
+        params.color[1] = dab.color.g * alpha;
+        params.color[2] = dab.color.b * alpha;
+        params.color[3] = dab.color.a * alpha;
+
+        for (int y = min.y; y < max.y; y++) {
+            const float dy = static_cast<float>(origin.y + y) - dab.position.y;
+            paint_row(pixels.data() + static_cast<size_t>(y) * resolution + min.x, max.x - min.x,
+                      static_cast<float>(origin.x + min.x), dy * dy, params);
+        }
+    }
+}
+
+Rasterizer::Backend Rasterizer::GetBackend() {
+    static const Backend backend = [] {
+        for (const auto backend : {Backend::Avx2, Backend::Neon, Backend::Sse2}) {
+            if (IsSupported(backend)) {
+                return backend;
+            }
+        }
+        return Backend::Scalar;
+    }();
+    return backend;
+}
+
+bool Rasterizer::IsSupported(Backend backend) {
+    return GetPaintRow(backend) != nullptr;
+}
+
+const char *Rasterizer::GetName(Backend backend) {
+    switch (backend) {
+    case Backend::Scalar:
+        return "scalar";
+    case Backend::Sse2:
+        return "sse2";
+    case Backend::Avx2:
+        return "avx2";
+    case Backend::Neon:
+        return "neon";
+    }
+    return "unknown";
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "Renderer.h"
 #include "Framework.h"
 #include "Log.h"
+#include <algorithm>
 #include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 #include <stdexcept>
@@ -83,6 +84,12 @@ void Program::SetVec2(const std::string &name, glm::vec2 value) {
     }
 }
 
+void Program::SetIVec2(const std::string &name, glm::ivec2 value) {
+    if (_uniforms.contains(name)) {
+        glUniform2iv(_uniforms[name].location, 1, glm::value_ptr(value));
+    }
+}
+
 void Program::SetVec3(const std::string &name, glm::vec3 value) {
     if (_uniforms.contains(name)) {
         glUniform3fv(_uniforms[name].location, 1, glm::value_ptr(value));
@@ -194,6 +201,11 @@ void Mesh::Render(GLenum mode, GLsizei count) {
     }
 }
 
+void Mesh::RenderInstanced(GLenum mode, GLsizei count, GLsizei instances) {
+    glBindVertexArray(_vao);
+    glDrawArraysInstanced(mode, 0, count, instances);
+}
+
 void Mesh::Release() {
     glDeleteVertexArrays(1, &_vao);
     _vao = 0;
@@ -373,7 +385,7 @@ std::vector<uint32_t> Texture::ReadPixels() const {
     return pixels;
 }
 
-void Texture::SetPixels(std::span<uint32_t> pixels) {
+void Texture::SetPixels(std::span<const uint32_t> pixels) {
     if (pixels.size() != _width * _height) {
         throw std::runtime_error("The supplied pixels are of the wrong size");
     }
@@ -383,6 +395,10 @@ void Texture::SetPixels(std::span<uint32_t> pixels) {
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void Texture::Fill(uint32_t color) {
+    glClearTexImage(_ID, 0, GL_RGBA, GL_UNSIGNED_BYTE, &color);
+}
+
 void Texture::Release() {
     glDeleteTextures(1, &_ID);
     _ID = 0;
@@ -390,6 +406,252 @@ void Texture::Release() {
     _height = 0;
 }
 
+TextureArray::TextureArray(const tstring &name, GLsizei width, GLsizei height, GLsizei layers) {
+    _name = RestoreStringA(name);
+    _width = width;
+    _height = height;
+    _layers = layers;
+    _ID = CreateStorage(_name, _width, _height, _layers);
+}
+
+TextureArray::~TextureArray() {
+    glDeleteTextures(1, &_ID);
+}
+
+std::unique_ptr<TextureArray> TextureArray::Create(const tstring &name, GLsizei width, GLsizei height,
+                                                   GLsizei layers) {
+    return std::make_unique<TextureArray>(name, width, height, layers);
+}
+
+GLuint TextureArray::CreateStorage(const std::string &name, GLsizei width, GLsizei height, GLsizei layers) {
+    GLuint id = 0;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+    glObjectLabel(GL_TEXTURE, id, name.size(), name.c_str());
+    glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureStorage3D(id, 1, GL_RGBA8, width, height, layers);
+    return id;
+}
+
+void TextureArray::Resize(GLsizei layers) {
+    GLint max_layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    if (layers > max_layers) {
+        throw std::runtime_error("Too many layers for a texture array");
+    }
+
+    const GLuint id = CreateStorage(_name, _width, _height, layers);
+    glCopyImageSubData(_ID, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, _width, _height,
+                       std::min(_layers, layers));
+    glDeleteTextures(1, &_ID);
+
+    _ID = id;
+    _layers = layers;
+}
+
+std::vector<uint32_t> TextureArray::ReadPixels(GLint layer) const {
+    return ReadPixels(layer, {0, 0}, {_width, _height});
+}
+
+std::vector<uint32_t> TextureArray::ReadPixels(GLint layer, glm::ivec2 offset, glm::ivec2 size) const {
+    auto pixels = std::vector<std::uint32_t>(size.x * size.y);
+    glGetTextureSubImage(_ID, 0, offset.x, offset.y, layer, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                         pixels.size() * sizeof(uint32_t), pixels.data());
+
+    return pixels;
+}
+
+void TextureArray::SetPixels(GLint layer, std::span<const uint32_t> pixels) {
+    if (pixels.size() != _width * _height) {
+        throw std::runtime_error("The supplied pixels are of the wrong size");
+    }
+
+    glTextureSubImage3D(_ID, 0, 0, 0, layer, _width, _height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
+
+void TextureArray::Fill(GLint layer, uint32_t color) {
+    glClearTexSubImage(_ID, 0, 0, 0, layer, _width, _height, 1, GL_RGBA, GL_UNSIGNED_BYTE, &color);
+}
+
+void TextureArray::Bind(GLuint unit) const noexcept {
+    glBindTextureUnit(unit, _ID);
+}
+
+GLuint TextureArray::ID() const noexcept {
+    return _ID;
+}
+
+GLsizei TextureArray::Width() const noexcept {
+    return _width;
+}
+
+GLsizei TextureArray::Height() const noexcept {
+    return _height;
+}
+
+GLsizei TextureArray::Layers() const noexcept {
+    return _layers;
+}
+
+Readback::Readback(const tstring &name, GLsizeiptr size) {
+    _name = RestoreStringA(name);
+    _size = size;
+    _fence = nullptr;
+
+    // Persistently mapped so collecting the pixels is a copy and never a map or a stall
+    constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &_ID);
+    glObjectLabel(GL_BUFFER, _ID, _name.size(), _name.c_str());
+    glNamedBufferStorage(_ID, _size, nullptr, flags);
+    _data = reinterpret_cast<const uint32_t *>(glMapNamedBufferRange(_ID, 0, _size, flags));
+}
+
+Readback::~Readback() {
+    Release();
+}
+
+std::unique_ptr<Readback> Readback::Create(const tstring &name, GLsizeiptr size) {
+    return std::make_unique<Readback>(name, size);
+}
+
+void Readback::Request(const TextureArray &texture, GLint layer) {
+    if (IsPending()) {
+        throw std::runtime_error("The readback is already pending");
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _ID);
+    glGetTextureSubImage(texture.ID(), 0, 0, 0, layer, texture.Width(), texture.Height(), 1, GL_RGBA,
+                         GL_UNSIGNED_BYTE, _size, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    _fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool Readback::IsPending() const noexcept {
+    return _fence != nullptr;
+}
+
+bool Readback::IsReady() const {
+    if (!_fence) {
+        return false;
+    }
+
+    const auto status = glClientWaitSync(_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+std::vector<uint32_t> Readback::Collect() {
+    if (!_fence) {
+        throw std::runtime_error("Nothing was requested from the readback");
+    }
+
+    while (glClientWaitSync(_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(_fence);
+    _fence = nullptr;
+
+    return std::vector<uint32_t>(_data, _data + _size / sizeof(uint32_t));
+}
+
+void Readback::Release() {
+    if (_fence) {
+        glDeleteSync(_fence);
+        _fence = nullptr;
+    }
+    glUnmapNamedBuffer(_ID);
+    glDeleteBuffers(1, &_ID);
+    _ID = 0;
+    _data = nullptr;
+}
+
+Storagebuffer::Storagebuffer(const tstring &name, GLuint binding, GLsizeiptr size) {
+    _name = RestoreStringA(name);
+    _ID = 0;
+    _binding = binding;
+    _size = 0;
+    _data = nullptr;
+    _start = 0;
+    _end = 0;
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    _alignment = std::max<GLint>(alignment, 1);
+
+    Reserve(size);
+}
+
+Storagebuffer::~Storagebuffer() {
+    Release();
+}
+
+std::unique_ptr<Storagebuffer> Storagebuffer::Create(const tstring &name, GLuint binding, GLsizeiptr size) {
+    return std::make_unique<Storagebuffer>(name, binding, size);
+}
+
+void *Storagebuffer::Allocate(GLsizeiptr size) {
+    // The commands using the previous allocation are all issued by now
+    if (_end > _start) {
+        _fences.push_back({_start, _end, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+    }
+
+    if (size > _size) {
+        Reserve(std::max(size, _size * 2));
+    }
+
+    _start = (_end + _alignment - 1) / _alignment * _alignment;
+    if (_start + size > _size) {
+        _start = 0;
+    }
+    _end = _start + size;
+
+    // Commands complete in order, waiting for the newest overlapping fence covers all the older ones
+    const auto overlap = std::find_if(_fences.rbegin(), _fences.rend(), [this](const Fence &fence) {
+        return fence.start < _end && _start < fence.end;
+    });
+    if (overlap != _fences.rend()) {
+        while (glClientWaitSync(overlap->sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        const auto count = std::distance(overlap, _fences.rend());
+        for (auto fence = _fences.begin(); fence != _fences.begin() + count; fence++) {
+            glDeleteSync(fence->sync);
+        }
+        _fences.erase(_fences.begin(), _fences.begin() + count);
+    }
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, _binding, _ID, _start, std::max<GLsizeiptr>(size, 1));
+    return _data + _start;
+}
+
+void Storagebuffer::Reserve(GLsizeiptr size) {
+    // The old buffer is only freed by GL once the commands using it are done, its fences are not needed anymore
+    Release();
+
+    _size = size;
+    _start = 0;
+    _end = 0;
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &_ID);
+    glObjectLabel(GL_BUFFER, _ID, _name.size(), _name.c_str());
+    glNamedBufferStorage(_ID, _size, nullptr, flags);
+    _data = reinterpret_cast<std::uint8_t *>(glMapNamedBufferRange(_ID, 0, _size, flags));
+}
+
+void Storagebuffer::Release() {
+    for (const auto &fence : _fences) {
+        glDeleteSync(fence.sync);
+    }
+    _fences.clear();
+
+    if (_ID) {
+        glUnmapNamedBuffer(_ID);
+        glDeleteBuffers(1, &_ID);
+        _ID = 0;
+    }
+    _data = nullptr;
+}
+
 std::unique_ptr<Mesh> Framebuffer::_mesh;
 std::unique_ptr<Program> Framebuffer::_program;
 
@@ -471,6 +733,18 @@ void Framebuffer::Render() {
     _mesh->Render(GL_TRIANGLES, 3);
 }
 
+GLsizei Framebuffer::Width() const noexcept {
+    return _texture->Width();
+}
+
+GLsizei Framebuffer::Height() const noexcept {
+    return _texture->Height();
+}
+
+std::vector<uint32_t> Framebuffer::ReadPixels() const {
+    return _texture->ReadPixels();
+}
+
 Framebuffer::Framebuffer() {
     _width  = 0;
     _height = 0;
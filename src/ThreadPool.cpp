@@ -0,0 +1,52 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t thread_count) : _stop(false) {
+    _threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        _threads.emplace_back(&ThreadPool::Work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+
+    // The remaining tasks are still executed so no future is left without a value
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+}
+
+std::unique_ptr<ThreadPool> ThreadPool::Create(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return std::make_unique<ThreadPool>(thread_count);
+}
+
+size_t ThreadPool::Size() const noexcept {
+    return _threads.size();
+}
+
+void ThreadPool::Work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(_mutex);
+            _condition.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+            if (_stop && _tasks.empty()) {
+                return;
+            }
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+
+        task();
+    }
+}
\ No newline at end of file
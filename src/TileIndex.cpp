@@ -0,0 +1,108 @@
+#include "TileIndex.h"
+
+#include <algorithm>
+
+TileIndex::TileIndex() : _slots(16), _size(0) {
+}
+
+std::uint64_t TileIndex::Pack(int x, int y) noexcept {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+}
+
+size_t TileIndex::GetSlot(std::uint64_t key) const noexcept {
+    // Fibonacci hashing, neighbouring coords end up far apart so the probes stay short
+    key ^= key >> 29;
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (_slots.size() - 1);
+}
+
+size_t TileIndex::Probe(std::uint64_t key) const noexcept {
+    const size_t mask = _slots.size() - 1;
+    size_t slot = GetSlot(key);
+    while (_slots[slot].index != empty && _slots[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+std::optional<size_t> TileIndex::Find(int x, int y) const {
+    const auto &slot = _slots[Probe(Pack(x, y))];
+    if (slot.index == empty) {
+        return std::nullopt;
+    }
+
+    return slot.index;
+}
+
+bool TileIndex::Contains(int x, int y) const {
+    return _slots[Probe(Pack(x, y))].index != empty;
+}
+
+bool TileIndex::Insert(int x, int y, size_t index) {
+    // Kept at most half full
+    if ((_size + 1) * 2 > _slots.size()) {
+        Rehash(_slots.size() * 2);
+    }
+
+    const auto key = Pack(x, y);
+    auto &slot = _slots[Probe(key)];
+    if (slot.index != empty) {
+        return false;
+    }
+
+    slot = {key, index};
+    _size++;
+    return true;
+}
+
+void TileIndex::Erase(int x, int y) {
+    const size_t mask = _slots.size() - 1;
+    size_t hole = Probe(Pack(x, y));
+    if (_slots[hole].index == empty) {
+        return;
+    }
+
+    // Move back the entries of the cluster that would not be found anymore past the hole, no tombstones needed
+    for (size_t slot = (hole + 1) & mask; _slots[slot].index != empty; slot = (slot + 1) & mask) {
+        const size_t home = GetSlot(_slots[slot].key);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            _slots[hole] = _slots[slot];
+            hole = slot;
+        }
+    }
+
+    _slots[hole] = Slot();
+    _size--;
+}
+
+void TileIndex::Clear() {
+    std::fill(_slots.begin(), _slots.end(), Slot());
+    _size = 0;
+}
+
+size_t TileIndex::Size() const noexcept {
+    return _size;
+}
+
+std::vector<std::pair<int, int>> TileIndex::GetCoords() const {
+    std::vector<std::pair<int, int>> coords;
+    coords.reserve(_size);
+
+    for (const auto &slot : _slots) {
+        if (slot.index != empty) {
+            coords.push_back({static_cast<int>(slot.key >> 32), static_cast<int>(slot.key & 0xFFFFFFFF)});
+        }
+    }
+
+    return coords;
+}
+
+void TileIndex::Rehash(size_t capacity) {
+    auto slots = std::move(_slots);
+    _slots = std::vector<Slot>(capacity);
+
+    for (const auto &slot : slots) {
+        if (slot.index != empty) {
+            _slots[Probe(slot.key)] = slot;
+        }
+    }
+}
\ No newline at end of file
@@ -1,10 +1,12 @@
 #include "Viewport.h"
 
+#include <cmath>
+#include <limits>
+#include <glm/common.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-Viewport::Viewport(glm::ivec2 size) {
-	_buffer = Uniformbuffer::Create(TEXT("Viewport Matrices"), 0, sizeof(Matrices), nullptr);
-
+Viewport::Viewport(glm::ivec2 size)
+	: _matrices{glm::mat4(1.0f), glm::mat4(1.0f)}, _position(0.0f), _rotation(0.0f), _zoom(1.0f), _size(size), _aabb() {
 	SetSize(size);
 	SetPosition({ 0.0f, 0.0f }, false);
 	SetZoom(1.0f, false);
@@ -57,24 +59,51 @@ float Viewport::GetZoom() const noexcept {
 	return _zoom;
 }
 
-bool Viewport::IsVisible(AABB other) {
+bool Viewport::IsVisible(AABB other) const noexcept {
 	return AABB::Overlap(_aabb, other);
 }
 
+AABB Viewport::GetBounds() const noexcept {
+	return _aabb;
+}
+
+Viewport::TileRange Viewport::GetTileRange(int tile_resolution) const noexcept {
+	// Tiles only touching the edge of the viewport are not in the range
+	const auto resolution = glm::vec2(static_cast<float>(tile_resolution));
+	return {glm::ivec2(glm::floor(_aabb.min / resolution)), glm::ivec2(glm::ceil(_aabb.max / resolution)) - 1};
+}
+
+void Viewport::UpdateBounds() {
+	// The view matrix is translate * scale * rotate, so a point of the window is position + zoom * rotate(point)
+	const float angle = glm::radians(_rotation);
+	const float cos = std::cos(angle);
+	const float sin = std::sin(angle);
+	// Same corners as the projection matrix
+	const glm::vec2 min = -glm::floor(glm::vec2(_size) / 2.0f);
+	const glm::vec2 max = glm::ceil(glm::vec2(_size) / 2.0f);
+	const glm::vec2 corners[4] = {{min.x, min.y}, {max.x, min.y}, {max.x, max.y}, {min.x, max.y}};
+
+	_aabb = {glm::vec2(std::numeric_limits<float>::max()), glm::vec2(std::numeric_limits<float>::lowest())};
+	for (const auto corner : corners) {
+		const glm::vec2 point = (corner - _position) / _zoom;
+		const glm::vec2 canvas = {point.x * cos + point.y * sin, point.y * cos - point.x * sin};
+		_aabb.min = glm::min(_aabb.min, canvas);
+		_aabb.max = glm::max(_aabb.max, canvas);
+	}
+}
+
 void Viewport::UpdateViewMatrix() {
 	const auto translation = glm::translate(glm::mat4(1.0f), glm::vec3(_position, 0.0f));
 	const auto rotation = glm::rotate(glm::mat4(1.0f), glm::radians(_rotation), glm::vec3(0.0f, 0.0f, 1.0f));
 	const auto scale = glm::scale(glm::mat4(1.0f), glm::vec3(_zoom));
 
 	_matrices.view = translation * scale * rotation;
-	_buffer->SetData(offsetof(Matrices, view), sizeof(Matrices::view), &_matrices.view);
 
-	_aabb = { {0.0f, 0.0f},{1.0f, 1.0f} };
+	UpdateBounds();
 }
 
 void Viewport::UpdateProjMatrix() {
 	_matrices.proj = glm::ortho(-std::floor(_size.x / 2.0f), std::ceil(_size.x / 2.0f), -std::floor(_size.y / 2.0f), std::ceil(_size.y / 2.0f));
-	_buffer->SetData(offsetof(Matrices, proj), sizeof(Matrices::proj), &_matrices.proj);
 
-	_aabb = { {0.0f, 0.0f},{1.0f, 1.0f} };
+	UpdateBounds();
 }
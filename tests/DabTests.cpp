@@ -0,0 +1,41 @@
+#include "Dab.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+static Dab MakeDab(glm::vec2 position, float pressure) {
+    Dab dab{};
+    dab.position = position;
+    dab.pressure = pressure;
+    dab.color = {0.0f, 0.0f, 0.0f, 1.0f};
+    return dab;
+}
+
+TEST_CASE("Dabs are spaced by step from start to end", "[dab]") {
+    const auto start = MakeDab({0.0f, 0.0f}, 1.0f);
+    const auto end = MakeDab({100.0f, 0.0f}, 0.5f);
+
+    const auto dabs = Dab::Interpolate(start, end, 10.0f);
+    REQUIRE(dabs.size() == 10);
+    REQUIRE(dabs.front().position == start.position);
+    REQUIRE(dabs.back().position == end.position);
+    REQUIRE(dabs.back().pressure == end.pressure);
+    for (size_t i = 1; i < dabs.size(); i++) {
+        REQUIRE(dabs[i].position.x > dabs[i - 1].position.x);
+    }
+}
+
+TEST_CASE("No dabs between the same positions", "[dab]") {
+    const auto dab = MakeDab({5.0f, 5.0f}, 1.0f);
+    REQUIRE(Dab::Interpolate(dab, dab, 1.0f).empty());
+}
+
+TEST_CASE("Dab bounds cover the radius scaled by pressure", "[dab]") {
+    const Dab dabs[] = {MakeDab({0.0f, 0.0f}, 1.0f), MakeDab({10.0f, 20.0f}, 0.5f), MakeDab({100.0f, 100.0f}, 0.0f)};
+
+    const auto bounds = Dab::GetBounds(dabs);
+    REQUIRE(bounds.min == glm::vec2(-Dab::radius));
+    REQUIRE(bounds.max == glm::vec2(10.0f, 20.0f) + Dab::radius * 0.5f);
+
+    const auto empty = Dab::GetBounds({});
+    REQUIRE(empty.min.x > empty.max.x);
+}
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "File.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+
+static std::vector<uint32_t> MakePixels(int resolution, uint32_t seed) {
+    std::vector<uint32_t> pixels(resolution * resolution);
+    std::iota(pixels.begin(), pixels.end(), seed);
+    return pixels;
+}
+
+TEST_CASE("Tiles are read back after a save", "[file]") {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-test-save.msh";
+    const int resolution = 64;
+
+    const auto png = MakePixels(resolution, 0);
+    const auto lz4 = MakePixels(resolution, 1000);
+    const auto zstd = MakePixels(resolution, 2000);
+    const std::vector<uint32_t> uniform(resolution * resolution, 0xFF00FF00);
+    {
+        auto file = File::New(filename, resolution);
+        file->WriteTileTexture(0, 0, png, TileCodec::Png);
+        file->WriteTileTexture(-1, 0, lz4, TileCodec::Lz4);
+        file->WriteTileTexture(0, -1, zstd, TileCodec::Zstd);
+        file->WriteTileTexture(3, 3, uniform, TileCodec::Png);
+        file->Save(filename);
+    }
+
+    auto file = File::Open(filename);
+    REQUIRE(file->GetTileResolution() == resolution);
+    REQUIRE(file->GetSavedTileLocation().size() == 4);
+    REQUIRE(file->GetSavedTileCount() == 4);
+    REQUIRE(file->ReadTileTexture(0, 0) == png);
+    REQUIRE(file->ReadTileTexture(-1, 0) == lz4);
+    REQUIRE(file->ReadTileTexture(0, -1) == zstd);
+    REQUIRE(file->GetTileColor(3, 3) == 0xFF00FF00);
+    REQUIRE_FALSE(file->GetTileColor(0, 0).has_value());
+    REQUIRE(file->ReadTileTexture(3, 3) == uniform);
+
+    ThreadPool pool(2);
+    REQUIRE(file->ReadTileTextureAsync(0, -1, &pool).get() == zstd);
+    REQUIRE(file->ReadTileTextureAsync(3, 3, nullptr).get() == uniform);
+    REQUIRE_FALSE(file->HasTile(1, 1));
+
+    file.reset();
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("An explicit save stores the tiles with its own codec", "[file]") {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-test-recode.msh";
+    const int resolution = 32;
+
+    const auto lazy = MakePixels(resolution, 0);
+    const auto saved = MakePixels(resolution, 100);
+    const std::vector<uint32_t> uniform(resolution * resolution, 0xFF0000FF);
+    ThreadPool pool(2);
+    {
+        // Like Canvas::LazySave then Canvas::Save, the first tiles are committed with the lazy codec
+        auto file = File::New(filename, resolution);
+        std::vector<File::TileTexture> tiles;
+        tiles.push_back({0, 0, lazy});
+        tiles.push_back({1, 0, lazy});
+        tiles.push_back({2, 0, uniform});
+        file->QueueTileTextures(std::move(tiles), &pool, TileCodec::Lz4);
+        file->CommitTileTextures(true);
+        REQUIRE(file->GetTileCodec(0, 0) == TileCodec::Lz4);
+
+        file->WriteTileTexture(0, 1, saved, TileCodec::Png);
+        file->RecodeTileTextures(&pool, TileCodec::Png);
+        file->Save(filename);
+    }
+
+    auto file = File::Open(filename);
+    REQUIRE(file->GetTileCodec(0, 0) == TileCodec::Png);
+    REQUIRE(file->GetTileCodec(1, 0) == TileCodec::Png);
+    REQUIRE(file->GetTileCodec(0, 1) == TileCodec::Png);
+    REQUIRE(file->GetTileCodec(2, 0) == TileCodec::Uniform);
+    REQUIRE_FALSE(file->GetTileCodec(5, 5).has_value());
+    REQUIRE(file->ReadTileTexture(0, 0) == lazy);
+    REQUIRE(file->ReadTileTexture(1, 0) == lazy);
+    REQUIRE(file->ReadTileTexture(0, 1) == saved);
+
+    // The tiles already on disk are left as they are
+    const auto later = MakePixels(resolution, 200);
+    file->WriteTileTexture(3, 0, later, TileCodec::Zstd);
+    file->RecodeTileTextures(nullptr, TileCodec::Lz4);
+    REQUIRE(file->GetTileCodec(0, 0) == TileCodec::Png);
+    REQUIRE(file->GetTileCodec(3, 0) == TileCodec::Lz4);
+    file->Save(filename);
+    REQUIRE(File::Open(filename, false)->ReadTileTexture(3, 0) == later);
+
+    file.reset();
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("Older saves can still be opened", "[file]") {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-test-generation.msh";
+    const int resolution = 32;
+
+    const auto first = MakePixels(resolution, 0);
+    const auto second = MakePixels(resolution, 1);
+    {
+        auto file = File::New(filename, resolution);
+        file->WriteTileTexture(0, 0, first);
+        file->Save(filename);
+        file->WriteTileTexture(0, 0, second);
+        file->Save(filename);
+    }
+
+    REQUIRE(File::Open(filename, true, 0)->ReadTileTexture(0, 0) == second);
+    REQUIRE(File::Open(filename, false, 1)->ReadTileTexture(0, 0) == first);
+
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("Files without a footer are still read", "[file]") {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-test-legacy.msh";
+    const int resolution = 16;
+
+    // Layout of 0.0.2.0, INFO then 24 bytes HEADER entries of coord, start and len, then the PNG BODY
+    const std::array<std::vector<uint32_t>, 2> tiles = {MakePixels(resolution, 0), MakePixels(resolution, 300)};
+    const std::array<std::array<int32_t, 2>, 2> coords = {{{0, 0}, {-2, 5}}};
+    std::array<std::vector<uint8_t>, 2> bodies;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        bodies[i] = Codec::Get(TileCodec::Png)->Encode(resolution, resolution, tiles[i]);
+    }
+    {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        const auto write = [&](const auto &value) {
+            out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        };
+
+        out.write("msh", 4);
+        write(std::array<uint8_t, 4>{0, 0, 2, 0});
+        write(uint64_t{0});
+        write(static_cast<uint32_t>(tiles.size()));
+        write(static_cast<uint32_t>(resolution));
+
+        uint64_t start = 24 + 24 * tiles.size();
+        for (size_t i = 0; i < tiles.size(); i++) {
+            write(coords[i]);
+            write(start);
+            write(static_cast<uint64_t>(bodies[i].size()));
+            start += bodies[i].size();
+        }
+        for (const auto &body : bodies) {
+            out.write(reinterpret_cast<const char *>(body.data()), body.size());
+        }
+    }
+
+    for (const bool mapped : {true, false}) {
+        auto file = File::Open(filename, mapped);
+        REQUIRE(file->GetTileResolution() == resolution);
+        REQUIRE(file->GetSavedTileCount() == tiles.size());
+        REQUIRE(file->GetSavedTileCount(1) == 0);
+        for (size_t i = 0; i < tiles.size(); i++) {
+            REQUIRE(file->ReadTileTexture(coords[i][0], coords[i][1]) == tiles[i]);
+        }
+    }
+
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("Pyramid tiles are stored apart from the canvas tiles", "[file]") {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-test-pyramid.msh";
+    const int resolution = 32;
+
+    const auto tile = MakePixels(resolution, 0);
+    const auto overview = MakePixels(resolution, 500);
+    const auto updated = MakePixels(resolution, 600);
+    const std::vector<uint32_t> uniform(resolution * resolution, 0xFF0000FF);
+    {
+        auto file = File::New(filename, resolution);
+        std::vector<File::TileTexture> tiles;
+        tiles.push_back({0, 0, tile});
+        tiles.push_back({0, 0, overview, 1});
+        tiles.push_back({-1, 0, uniform, Pyramid::max_level});
+        file->WriteTileTextures(std::move(tiles), nullptr, TileCodec::Lz4);
+        file->Save(filename);
+
+        tiles.clear();
+        tiles.push_back({0, 0, updated, 1});
+        file->WriteTileTextures(std::move(tiles), nullptr, TileCodec::Zstd);
+        file->Save(filename);
+    }
+
+    auto file = File::Open(filename);
+    REQUIRE(file->GetSavedTileCount() == 1);
+    REQUIRE(file->GetSavedTileCount(1) == 1);
+    REQUIRE(file->GetSavedTileCount(2) == 0);
+    REQUIRE_FALSE(file->HasTile(-1, 0));
+    REQUIRE(file->HasTile(-1, 0, Pyramid::max_level));
+    REQUIRE(file->GetTileColor(-1, 0, Pyramid::max_level) == 0xFF0000FF);
+    REQUIRE(file->ReadTileTexture(0, 0) == tile);
+    REQUIRE(file->ReadTileTexture(0, 0, 1) == updated);
+    REQUIRE(file->ReadTileTextureAsync(0, 0, nullptr, 1).get() == updated);
+    REQUIRE(File::Open(filename, true, 1)->ReadTileTexture(0, 0, 1) == overview);
+    REQUIRE_THROWS(file->HasTile(0, 0, Pyramid::max_level + 1));
+
+    file.reset();
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("The last view is previewed without opening the file", "[file]") {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-test-preview.msh";
+    const int resolution = 32;
+
+    // A view twice as wide as it is tall, each 4x4 block of pixels averages to one pixel of the thumbnail
+    const int width = File::thumbnail_size * 4;
+    const int height = File::thumbnail_size * 2;
+    std::vector<uint32_t> view(width * height, 0xFF000000);
+    for (int x = 0; x < 4; x++) {
+        view[x] = 0xFF000000 | (x < 2 ? 0x40 : 0x80);
+    }
+    const auto preview = File::CreatePreview({12.0f, -4.0f}, 0.5f, 1.0f, view, width, height);
+    REQUIRE(preview.width == File::thumbnail_size);
+    REQUIRE(preview.height == File::thumbnail_size / 2);
+    REQUIRE(preview.thumbnail[0] == 0xFF000018);
+    REQUIRE(preview.thumbnail[1] == 0xFF000000);
+    {
+        auto file = File::New(filename, resolution);
+        file->WriteTileTexture(0, 0, MakePixels(resolution, 0));
+        file->Save(filename);
+        REQUIRE_FALSE(File::ReadPreview(filename).has_value());
+
+        file->SetPreview(preview);
+        file->WriteTileTexture(0, 0, MakePixels(resolution, 1));
+        file->Save(filename);
+    }
+
+    const auto read = File::ReadPreview(filename);
+    REQUIRE(read.has_value());
+    REQUIRE(read->position == glm::vec2(12.0f, -4.0f));
+    REQUIRE(read->zoom == 0.5f);
+    REQUIRE(read->rotation == 1.0f);
+    REQUIRE(read->width == preview.width);
+    REQUIRE(read->height == preview.height);
+    REQUIRE(read->thumbnail == preview.thumbnail);
+
+    // The preview is kept by the following saves and does not get in the way of the tiles
+    auto file = File::Open(filename);
+    REQUIRE(file->GetPreview()->thumbnail == preview.thumbnail);
+    REQUIRE(file->ReadTileTexture(0, 0) == MakePixels(resolution, 1));
+    REQUIRE_FALSE(File::Open(filename, true, 1)->GetPreview().has_value());
+    file->WriteTileTexture(1, 0, MakePixels(resolution, 2));
+    file->Save(filename);
+    file->Repack(filename);
+    REQUIRE(File::ReadPreview(filename)->thumbnail == preview.thumbnail);
+    REQUIRE(File::Open(filename, false)->ReadTileTexture(1, 0) == MakePixels(resolution, 2));
+
+    file.reset();
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("Tiles are not encoded with a codec that does not exist", "[file]") {
+    const int resolution = 16;
+    auto file = File::New(std::filesystem::temp_directory_path() / "mashiro-test-codec.msh", resolution);
+
+    REQUIRE_THROWS(file->WriteTileTexture(0, 0, MakePixels(resolution, 0), TileCodec::Uniform));
+    REQUIRE_THROWS(file->WriteTileTexture(0, 0, MakePixels(resolution, 0), static_cast<TileCodec>(42)));
+    REQUIRE_FALSE(file->HasTile(0, 0));
+
+    file->WriteTileTexture(0, 0, MakePixels(resolution, 0), TileCodec::Lz4);
+    REQUIRE_THROWS(file->RecodeTileTextures(nullptr, static_cast<TileCodec>(42)));
+    REQUIRE(file->ReadTileTexture(0, 0) == MakePixels(resolution, 0));
+}
+
+TEST_CASE("Tiles with the same content keep it when the tile they share it with changes", "[file]") {
+    const auto filename = std::filesystem::temp_directory_path() / "mashiro-test-share.msh";
+    const int resolution = 32;
+
+    const auto shared = MakePixels(resolution, 0);
+    const auto changed = MakePixels(resolution, 100);
+    {
+        auto file = File::New(filename, resolution);
+        file->WriteTileTexture(0, 0, shared, TileCodec::Lz4);
+        file->WriteTileTexture(1, 0, shared, TileCodec::Lz4);
+        file->WriteTileTexture(0, 0, changed, TileCodec::Lz4);
+        file->WriteTileTexture(2, 0, shared, TileCodec::Lz4);
+        REQUIRE(file->ReadTileTexture(1, 0) == shared);
+        file->Save(filename);
+    }
+
+    // Without the mapping the tiles read the BODY they share from memory
+    for (const bool mapped : {true, false}) {
+        auto file = File::Open(filename, mapped);
+        REQUIRE(file->ReadTileTexture(0, 0) == changed);
+        REQUIRE(file->ReadTileTexture(1, 0) == shared);
+        REQUIRE(file->ReadTileTexture(2, 0) == shared);
+    }
+
+    std::filesystem::remove(filename);
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "Prefetcher.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+
+TEST_CASE("Prefetcher extrapolates a steady pan", "[prefetcher]") {
+    Viewport viewport({800, 600});
+    Prefetcher prefetcher;
+
+    for (int frame = 0; frame < 10; frame++) {
+        viewport.SetPosition({frame * -10.0f, 0.0f});
+        prefetcher.Update(viewport, frame * 0.01);
+    }
+    REQUIRE(std::abs(prefetcher.GetVelocity().x + 1000.0f) < 10.0f);
+    REQUIRE(std::abs(prefetcher.GetVelocity().y) < 0.01f);
+
+    // Moving the view left shows the canvas on its right
+    const auto predicted = prefetcher.Predict(viewport, 0.1f);
+    REQUIRE(predicted.GetBounds().max.x > viewport.GetBounds().max.x + 90.0f);
+    REQUIRE(predicted.GetBounds().min.y == viewport.GetBounds().min.y);
+}
+
+TEST_CASE("Prefetcher extrapolates a zoom out", "[prefetcher]") {
+    Viewport viewport({800, 600});
+    Prefetcher prefetcher;
+
+    for (int frame = 0; frame < 10; frame++) {
+        viewport.SetZoom(std::pow(0.9f, static_cast<float>(frame)));
+        prefetcher.Update(viewport, frame * 0.01);
+    }
+    REQUIRE(prefetcher.GetZoomRate() < 0.0f);
+
+    const auto predicted = prefetcher.Predict(viewport, 0.1f);
+    REQUIRE(predicted.GetZoom() < viewport.GetZoom());
+    REQUIRE(predicted.GetBounds().max.x > viewport.GetBounds().max.x);
+}
+
+TEST_CASE("Prefetcher forgets the movement after a pause", "[prefetcher]") {
+    Viewport viewport({800, 600});
+    Prefetcher prefetcher;
+
+    viewport.SetPosition({0.0f, 0.0f});
+    prefetcher.Update(viewport, 0.0);
+    viewport.SetPosition({100.0f, 0.0f});
+    prefetcher.Update(viewport, 0.01);
+    REQUIRE(prefetcher.GetVelocity().x > 0.0f);
+
+    prefetcher.Update(viewport, 1.0);
+    REQUIRE(prefetcher.GetVelocity() == glm::vec2(0.0f));
+    REQUIRE(prefetcher.Predict(viewport, 0.3f).GetBounds().min == viewport.GetBounds().min);
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "Pyramid.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("Pyramid parents cover 2x2 tiles", "[pyramid]") {
+    REQUIRE(Pyramid::GetParent({0, 0}) == glm::ivec2(0, 0));
+    REQUIRE(Pyramid::GetParent({3, 2}) == glm::ivec2(1, 1));
+    REQUIRE(Pyramid::GetParent({-1, -2}) == glm::ivec2(-1, -1));
+    REQUIRE(Pyramid::GetParent({-3, 5}) == glm::ivec2(-2, 2));
+
+    REQUIRE(Pyramid::GetQuadrant({3, 2}) == glm::ivec2(1, 0));
+    REQUIRE(Pyramid::GetQuadrant({-1, -2}) == glm::ivec2(1, 0));
+
+    REQUIRE(Pyramid::GetAncestor({13, -13}, 0) == glm::ivec2(13, -13));
+    REQUIRE(Pyramid::GetAncestor({13, -13}, 2) == Pyramid::GetParent(Pyramid::GetParent({13, -13})));
+    REQUIRE(Pyramid::GetAncestor({13, -13}, 2) == glm::ivec2(3, -4));
+}
+
+TEST_CASE("Pyramid level follows the zoom out", "[pyramid]") {
+    REQUIRE(Pyramid::GetLevel(4.0f) == 0);
+    REQUIRE(Pyramid::GetLevel(1.0f) == 0);
+    REQUIRE(Pyramid::GetLevel(0.6f) == 0);
+    REQUIRE(Pyramid::GetLevel(0.5f) == 1);
+    REQUIRE(Pyramid::GetLevel(0.2f) == 2);
+    REQUIRE(Pyramid::GetLevel(0.0001f) == Pyramid::max_level);
+    REQUIRE(Pyramid::GetLevel(0.0f) == 0);
+}
+
+TEST_CASE("Pyramid tiles are only complete once every tile under them is downsampled", "[pyramid]") {
+    // A painted tile next to a tile that is only in the file, their parent is created without a copy in the file
+    PyramidCoverage coverage;
+    coverage.AddTile({0, 0});
+    coverage.AddTile({1, 0});
+    coverage.AddTile({8, 8});
+    REQUIRE(coverage.HasContent(1, {0, 0}));
+    REQUIRE(coverage.HasContent(3, {1, 1}));
+    REQUIRE_FALSE(coverage.HasContent(1, {0, 1}));
+    REQUIRE_FALSE(coverage.HasContent(2, {1, 1}));
+
+    coverage.AddLevelTile(1, {0, 0}, false);
+    coverage.SetDownsampled(1, {0, 0});
+    REQUIRE_FALSE(coverage.IsComplete(1, {0, 0}));
+
+    // Its parent stays partial as long as it is
+    coverage.AddLevelTile(2, {0, 0}, false);
+    coverage.SetDownsampled(2, {0, 0});
+    REQUIRE_FALSE(coverage.IsComplete(2, {0, 0}));
+
+    coverage.SetDownsampled(1, {1, 0});
+    REQUIRE(coverage.IsComplete(1, {0, 0}));
+    REQUIRE_FALSE(coverage.IsComplete(2, {0, 0}));
+    coverage.SetDownsampled(2, {0, 0});
+    REQUIRE(coverage.IsComplete(2, {0, 0}));
+
+    // A complete tile read from the file becomes partial when a partial child is downsampled in it
+    coverage.AddLevelTile(4, {0, 0}, true);
+    REQUIRE(coverage.IsComplete(4, {0, 0}));
+    coverage.AddLevelTile(3, {1, 1}, false);
+    REQUIRE_FALSE(coverage.IsComplete(3, {1, 1}));
+    coverage.SetDownsampled(4, {1, 1});
+    REQUIRE_FALSE(coverage.IsComplete(4, {0, 0}));
+
+    REQUIRE(coverage.IsComplete(0, {5, 5}));
+    REQUIRE_FALSE(coverage.IsComplete(1, {5, 5}));
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "Rasterizer.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <vector>
+
+constexpr int resolution = 256;
+constexpr uint32_t default_color = 0x00FFFFFF;
+
+static Dab MakeDab(glm::vec2 position, float pressure, glm::vec4 color) {
+    Dab dab{};
+    dab.position = position;
+    dab.pressure = pressure;
+    dab.color = color;
+    return dab;
+}
+
+TEST_CASE("Only the pixels inside the radius are painted", "[rasterizer]") {
+    std::vector<uint32_t> pixels(resolution * resolution, default_color);
+    const Dab dab = MakeDab({128.0f, 128.0f}, 1.0f, {0.0f, 0.0f, 0.0f, 1.0f});
+
+    Rasterizer::Paint({&dab, 1}, {0, 0}, resolution, pixels);
+    REQUIRE(pixels[128 * resolution + 128] == 0xFF000000);
+    REQUIRE(pixels[128 * resolution + 132] == 0xFF000000);
+    REQUIRE(pixels[128 * resolution + 133] == default_color);
+    REQUIRE(pixels[131 * resolution + 131] == 0xFF000000);
+    REQUIRE(pixels[131 * resolution + 132] == default_color);
+}
+
+TEST_CASE("Pixels are mixed with the color by its alpha", "[rasterizer]") {
+    std::vector<uint32_t> pixels(resolution * resolution, default_color);
+    const Dab dab = MakeDab({0.0f, 0.0f}, 1.0f, {0.0f, 0.0f, 0.0f, 0.5f});
+
+    Rasterizer::Paint({&dab, 1}, {0, 0}, resolution, pixels);
+    REQUIRE(pixels[0] == 0x40808080);
+
+    Rasterizer::Paint({&dab, 1}, {0, 0}, resolution, pixels);
+    REQUIRE(pixels[0] == 0x60404040);
+}
+
+TEST_CASE("Dabs are painted in canvas coordinates", "[rasterizer]") {
+    std::vector<uint32_t> pixels(resolution * resolution, default_color);
+    const Dab dabs[] = {MakeDab({-1.0f, 2.0f * resolution}, 1.0f, {1.0f, 0.0f, 0.0f, 1.0f}),
+                        MakeDab({128.0f, 128.0f}, 1.0f, {1.0f, 0.0f, 0.0f, 1.0f})};
+
+    Rasterizer::Paint(dabs, {-1, 2}, resolution, pixels);
+    REQUIRE(pixels[resolution - 1] == 0xFF0000FF);
+    REQUIRE(pixels[128 * resolution + 128] == default_color);
+}
+
+TEST_CASE("Every backend paints the same pixels", "[rasterizer]") {
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-8.0f, resolution + 8.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<Dab> dabs;
+    for (int i = 0; i < 256; i++) {
+        dabs.push_back(MakeDab({position(rng) - resolution, position(rng)}, unit(rng) * 4.0f,
+                               {unit(rng), unit(rng), unit(rng), unit(rng)}));
+    }
+
+    std::vector<uint32_t> expected(resolution * resolution, default_color);
+    Rasterizer::Paint(Rasterizer::Backend::Scalar, dabs, {-1, 0}, resolution, expected);
+
+    for (const auto backend : {Rasterizer::Backend::Sse2, Rasterizer::Backend::Avx2, Rasterizer::Backend::Neon}) {
+        if (!Rasterizer::IsSupported(backend)) {
+            continue;
+        }
+
+        INFO(Rasterizer::GetName(backend));
+        std::vector<uint32_t> pixels(resolution * resolution, default_color);
+        Rasterizer::Paint(backend, dabs, {-1, 0}, resolution, pixels);
+        REQUIRE(pixels == expected);
+    }
+}
\ No newline at end of file
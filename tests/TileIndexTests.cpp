@@ -0,0 +1,75 @@
+#include "TileIndex.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+#include <random>
+
+TEST_CASE("Tile indexes are found by coord", "[tile_index]") {
+    TileIndex index;
+    REQUIRE(index.Size() == 0);
+    REQUIRE_FALSE(index.Find(0, 0).has_value());
+
+    REQUIRE(index.Insert(0, 0, 3));
+    REQUIRE(index.Insert(-1, 2, 7));
+    REQUIRE(index.Size() == 2);
+    REQUIRE(index.Find(0, 0) == 3);
+    REQUIRE(index.Find(-1, 2) == 7);
+    REQUIRE_FALSE(index.Contains(2, -1));
+}
+
+TEST_CASE("Tile indexes are not overwritten", "[tile_index]") {
+    TileIndex index;
+    REQUIRE(index.Insert(4, 5, 1));
+    REQUIRE_FALSE(index.Insert(4, 5, 2));
+    REQUIRE(index.Find(4, 5) == 1);
+}
+
+TEST_CASE("Tile indexes can be erased", "[tile_index]") {
+    TileIndex index;
+    index.Insert(0, 0, 0);
+    index.Insert(1, 0, 1);
+
+    index.Erase(0, 0);
+    REQUIRE_FALSE(index.Contains(0, 0));
+    REQUIRE(index.Contains(1, 0));
+
+    auto coords = index.GetCoords();
+    REQUIRE(coords == std::vector<std::pair<int, int>>{{1, 0}});
+
+    index.Clear();
+    REQUIRE(index.Size() == 0);
+}
+
+TEST_CASE("Tile indexes match a map after random inserts and erases", "[tile_index]") {
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> coord(-64, 64);
+
+    TileIndex index;
+    std::map<std::pair<int, int>, size_t> expected;
+    for (size_t i = 0; i < 20000; i++) {
+        const int x = coord(rng), y = coord(rng);
+        if (rng() % 3 == 0) {
+            index.Erase(x, y);
+            expected.erase({x, y});
+        } else {
+            REQUIRE(index.Insert(x, y, i) == expected.emplace(std::pair(x, y), i).second);
+        }
+    }
+
+    REQUIRE(index.Size() == expected.size());
+    for (int y = -64; y <= 64; y++) {
+        for (int x = -64; x <= 64; x++) {
+            const auto found = expected.find({x, y});
+            REQUIRE(index.Find(x, y) == (found == expected.end() ? std::nullopt : std::optional(found->second)));
+        }
+    }
+
+    std::vector<std::pair<int, int>> coords;
+    for (const auto &[coord, i] : expected) {
+        coords.push_back(coord);
+    }
+    auto found = index.GetCoords();
+    std::sort(found.begin(), found.end());
+    REQUIRE(found == coords);
+}
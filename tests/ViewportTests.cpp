@@ -0,0 +1,46 @@
+#include "Viewport.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("Viewport bounds follow the position and the zoom", "[viewport]") {
+    Viewport viewport({800, 600});
+    REQUIRE(viewport.GetBounds().min == glm::vec2(-400.0f, -300.0f));
+    REQUIRE(viewport.GetBounds().max == glm::vec2(400.0f, 300.0f));
+
+    viewport.SetPosition({100.0f, 0.0f});
+    REQUIRE(viewport.GetBounds().min == glm::vec2(-500.0f, -300.0f));
+    REQUIRE(viewport.GetBounds().max == glm::vec2(300.0f, 300.0f));
+
+    viewport.SetPosition({0.0f, 0.0f}, false);
+    viewport.SetZoom(2.0f);
+    REQUIRE(viewport.GetBounds().min == glm::vec2(-200.0f, -150.0f));
+    REQUIRE(viewport.GetBounds().max == glm::vec2(200.0f, 150.0f));
+}
+
+TEST_CASE("Viewport bounds contain the rotated window", "[viewport]") {
+    Viewport viewport({800, 600});
+    viewport.SetRotation(90.0f);
+
+    const auto bounds = viewport.GetBounds();
+    REQUIRE(std::abs(bounds.min.x + 300.0f) < 0.01f);
+    REQUIRE(std::abs(bounds.max.y - 400.0f) < 0.01f);
+
+    viewport.SetRotation(45.0f);
+    REQUIRE(viewport.GetBounds().max.x > 400.0f);
+}
+
+TEST_CASE("Viewport tile range covers the visible tiles only", "[viewport]") {
+    Viewport viewport({512, 512});
+
+    auto range = viewport.GetTileRange(256);
+    REQUIRE(range.first == glm::ivec2(-1, -1));
+    REQUIRE(range.last == glm::ivec2(0, 0));
+
+    viewport.SetPosition({-1.0f, 0.0f});
+    range = viewport.GetTileRange(256);
+    REQUIRE(range.first == glm::ivec2(-1, -1));
+    REQUIRE(range.last == glm::ivec2(1, 0));
+
+    REQUIRE(viewport.IsVisible({{256.0f, 0.0f}, {512.0f, 256.0f}}));
+    REQUIRE_FALSE(viewport.IsVisible({{-512.0f, 0.0f}, {-256.0f, 256.0f}}));
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "File.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+// Headless tool that writes a compacted copy of a .msh
+// Only the tiles reachable from the chosen index generation are kept and they are ordered by locality.
+// The source is mapped and the copy is streamed one tile at a time so memory stays bounded by the index.
+
+static void Usage() {
+    std::fprintf(stderr, "usage: mashiro-repack <input.msh> <output.msh> [--codec name] [--level n] [--compression 0-9] "
+                         "[--generation n]\n"
+                         "  --codec        re-encode every tile with png, lz4 or zstd, tiles are copied as is otherwise\n"
+                         "  --level        level of the codec, its default level otherwise\n"
+                         "  --compression  same as --codec png --level n\n"
+                         "  --generation   index generation to keep, 0 is the last save\n");
+}
+
+// False unless the whole argument is a number
+template <typename T> static bool ParseNumber(const char *arg, T &value) {
+    const auto end = arg + std::strlen(arg);
+    const auto [ptr, ec] = std::from_chars(arg, end, value);
+    return ec == std::errc() && ptr == end && ptr != arg;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    const std::filesystem::path input = argv[1];
+    const std::filesystem::path output = argv[2];
+    const Codec *codec = nullptr;
+    int level = -1;
+    size_t generation = 0;
+
+    for (int i = 3; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--codec" && i + 1 < argc) {
+            codec = Codec::Find(argv[++i]);
+            if (!codec) {
+                Usage();
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--level" && i + 1 < argc && ParseNumber(argv[i + 1], level)) {
+            i++;
+        } else if (arg == "--compression" && i + 1 < argc && ParseNumber(argv[i + 1], level)) {
+            codec = Codec::Get(TileCodec::Png);
+            i++;
+        } else if (arg == "--generation" && i + 1 < argc && ParseNumber(argv[i + 1], generation)) {
+            i++;
+        } else {
+            Usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (level >= 0 && (!codec || level < codec->min_level || level > codec->max_level)) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    try {
+        const auto input_size = std::filesystem::file_size(input);
+
+        auto file = File::Open(input, true, generation);
+        const auto tile_count = file->GetSavedTileCount();
+        size_t pyramid_count = 0;
+        for (int lod = 1; lod <= Pyramid::max_level; lod++) {
+            pyramid_count += file->GetSavedTileCount(lod);
+        }
+        file->Repack(output, codec ? std::optional<TileCodec>(codec->id) : std::nullopt, level);
+
+        const auto output_size = std::filesystem::file_size(output);
+        std::printf("%s: %zu tiles and %zu pyramid tiles, %ju -> %ju bytes\n", output.string().c_str(), tile_count,
+                    pyramid_count, static_cast<std::uintmax_t>(input_size), static_cast<std::uintmax_t>(output_size));
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "mashiro-repack: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file